@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// 替换全局的operator new/delete，统计整个程序的堆分配次数(包括其它线程中的分配)
+// 替换函数不能是inline的，每个可执行程序只能在一个源文件中包含这个头文件
+namespace demo {
+
+inline std::atomic<std::size_t> alloc_count{0};
+
+inline void *counted_alloc(std::size_t size) {
+    alloc_count.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size == 0 ? 1 : size)) { return ptr; }
+    throw std::bad_alloc{};
+}
+
+// 不内联，避免编译器看到operator new得到的指针被直接交给free而产生误报
+[[gnu::noinline]] inline void counted_free(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+}  // namespace demo
+
+void *operator new(std::size_t size) { return demo::counted_alloc(size); }
+
+void *operator new[](std::size_t size) { return demo::counted_alloc(size); }
+
+void operator delete(void *ptr) noexcept { demo::counted_free(ptr); }
+
+void operator delete[](void *ptr) noexcept { demo::counted_free(ptr); }
+
+void operator delete(void *ptr, std::size_t /*size*/) noexcept {
+    demo::counted_free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t /*size*/) noexcept {
+    demo::counted_free(ptr);
+}
@@ -0,0 +1,84 @@
+#include "allay/mlog/mlog.hpp"
+#include "../common/alloc_counter.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+namespace {
+
+constexpr int record_num = 20000;
+
+struct Result {
+    double allocs_per_record;
+    double ns_per_record;
+};
+
+template <typename Func>
+Result measure(Func &&func) {
+    for (int i = 0; i < 100; ++i) { func(i); }  // 预热，分配可复用的缓冲区
+
+    const std::size_t alloc_begin = demo::alloc_count.load();
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < record_num; ++i) { func(i); }
+    auto end = std::chrono::steady_clock::now();
+    const std::size_t alloc_end = demo::alloc_count.load();
+
+    return Result{
+        static_cast<double>(alloc_end - alloc_begin) / record_num,
+        std::chrono::duration<double, std::nano>(end - begin).count()
+            / record_num};
+}
+
+void report(const char *name, const Result &result) {
+    std::printf("%-36s allocs/record = %6.3f, time/record = %8.1f ns\n", name,
+                result.allocs_per_record, result.ns_per_record);
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    mlog::init(ZERO_CURRENT_SOURCE_DIR + std::string("/.mlog/"));
+    mlog::set_level_info();
+
+    mlog::create_logger("alloc")
+        .set_format(mlog::Format::LEVEL_SIGNATURE_TIME)
+        .link_file_trunc("alloc.log")
+        .lock();
+
+    const std::string name = "alloc";
+    const std::string str = "std::string";
+    constexpr std::string_view view = "std::string_view";
+
+    // 返回std::string的时间戳，每次都会分配
+    auto legacy_stamp = measure([](int) {
+        std::string stamp = MLogTool::time_stamp();
+        static_cast<void>(stamp);
+    });
+
+    // 直接追加到复用的缓冲区中
+    std::string buffer;
+    auto cached_stamp = measure([&buffer](int) {
+        buffer.clear();
+        MLogTool::append_time_stamp(buffer);
+    });
+
+    auto record = measure([&](int i) {
+        mlog::info(name) << " literal " << str << ' ' << view << " i = " << i
+                         << ", x = " << i * 0.5 << '\n';
+    });
+
+    report("MLogTool::time_stamp()", legacy_stamp);
+    report("MLogTool::append_time_stamp()", cached_stamp);
+    report("mlog::info(name) << ...", record);
+
+    // 稳态下每条记录不应该产生任何堆分配
+    if (cached_stamp.allocs_per_record > 0 || record.allocs_per_record > 0) {
+        std::printf("unexpected allocations on the record path\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include "allay/mlog/mlog.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int record_num = 20000;
+
+struct Latency {
+    double p50;
+    double p99;
+    double total_ms;
+};
+
+// 逐条记录调用方的耗时(ns)，返回p50/p99和总耗时
+template <typename Func>
+Latency measure(Func &&func) {
+    std::vector<double> samples(record_num);
+
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < record_num; ++i) {
+        auto t0 = std::chrono::steady_clock::now();
+        func(i);
+        auto t1 = std::chrono::steady_clock::now();
+        samples[static_cast<std::size_t>(i)] =
+            std::chrono::duration<double, std::nano>(t1 - t0).count();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    std::ranges::sort(samples);
+    return Latency{samples[samples.size() / 2],
+                   samples[samples.size() * 99 / 100],
+                   std::chrono::duration<double, std::milli>(end - begin)
+                       .count()};
+}
+
+void report(const char *name, const Latency &latency) {
+    std::printf("%-24s p50 = %8.0f ns, p99 = %8.0f ns, total = %8.2f ms\n",
+                name, latency.p50, latency.p99, latency.total_ms);
+}
+
+void report(const char *name, const MLogger::AsyncStats &stats) {
+    std::printf("%-24s enqueued = %llu, written = %llu, dropped = %llu\n", name,
+                static_cast<unsigned long long>(stats.enqueued),
+                static_cast<unsigned long long>(stats.written),
+                static_cast<unsigned long long>(stats.dropped));
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    mlog::init(ZERO_CURRENT_SOURCE_DIR + std::string("/.mlog/"));
+    mlog::set_level_info();
+
+    mlog::create_logger("sync").link_file_trunc("sync.log").lock();
+
+    mlog::create_logger("async")
+        .link_file_trunc("async.log")
+        .enable_async(8192, mlog::Overflow::BLOCK)
+        .lock();
+
+    mlog::create_logger("async_drop")
+        .link_file_trunc("async_drop.log")
+        .enable_async(256, mlog::Overflow::DROP_NEWEST)
+        .lock();
+
+    auto sync_latency = measure([](int i) {
+        mlog::info("sync") << " i = " << i << ", x = " << i * 0.5 << '\n';
+    });
+    mlog::get_logger("sync").flush();
+
+    auto async_latency = measure([](int i) {
+        mlog::info("async") << " i = " << i << ", x = " << i * 0.5 << '\n';
+    });
+    mlog::get_logger("async").flush();
+
+    auto drop_latency = measure([](int i) {
+        mlog::info("async_drop") << " i = " << i << ", x = " << i * 0.5
+                                 << '\n';
+    });
+    mlog::get_logger("async_drop").flush();
+
+    report("sync", sync_latency);
+    report("async (block)", async_latency);
+    report("async (drop newest)", drop_latency);
+
+    report("async (block)", mlog::get_logger("async").get_async_stats());
+    report("async (drop newest)",
+           mlog::get_logger("async_drop").get_async_stats());
+
+    return 0;
+}
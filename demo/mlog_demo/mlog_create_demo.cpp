@@ -0,0 +1,69 @@
+#include "allay/mlog/mlog.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int logger_num = 10000;
+
+// 对字面量名称可以在编译期检查
+static_assert(MLogTool::check_filename_valid("task_0.log"));
+static_assert(!MLogTool::check_filename_valid("task/0.log"));
+
+// 原来基于正则表达式的实现，只用于比较
+bool check_filename_valid_regex(const std::string &file_name) {
+    std::regex reg_express("[\\/:*?\"<>|]");
+    return (!std::regex_search(file_name, reg_express)
+            && (file_name.size() <= 100));
+}
+
+template <typename Func>
+double measure(const std::vector<std::string> &names, Func &&func) {
+    auto begin = std::chrono::steady_clock::now();
+    for (const auto &name : names) { func(name); }
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - begin).count()
+           / static_cast<double>(names.size());
+}
+
+void report(const char *name, double ns_per_logger) {
+    std::printf("%-28s time/logger = %8.1f ns\n", name, ns_per_logger);
+}
+
+}  // namespace
+
+// 模拟为每个任务创建一个logger的服务启动过程
+// 比较名称检查的两种实现，以及创建logger的总开销
+int main() {
+    mlog::init();
+
+    std::vector<std::string> names;
+    names.reserve(logger_num);
+    for (int i = 0; i < logger_num; ++i) {
+        names.push_back("task_" + std::to_string(i));
+    }
+
+    int valid_num = 0;
+    auto t1 = measure(names, [&valid_num](const std::string &name) {
+        valid_num += check_filename_valid_regex(name) ? 1 : 0;
+    });
+    auto t2 = measure(names, [&valid_num](const std::string &name) {
+        valid_num += MLogTool::check_filename_valid(name) ? 1 : 0;
+    });
+    auto t3 = measure(names, [](const std::string &name) {
+        mlog::create_logger(name).link_none();
+    });
+
+    report("regex name check", t1);
+    report("linear name check", t2);
+    report("create_logger", t3);
+    std::printf("valid names: %d, total create time: %.2f ms\n", valid_num,
+                t3 * logger_num / 1e6);
+
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include "allay/mlog/mlog.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+namespace {
+
+constexpr int record_num = 50000;
+
+template <typename Func>
+double measure(Func &&func) {
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < record_num; ++i) { func(i); }
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - begin).count()
+           / record_num;
+}
+
+void report(const char *name, double ns_per_record) {
+    std::printf("%-28s caller time/record = %8.1f ns\n", name, ns_per_record);
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    mlog::init(ZERO_CURRENT_SOURCE_DIR + std::string("/.mlog/"));
+    mlog::set_level_info();
+
+    auto &sync_stream = mlog::create_logger("sync_stream")
+                            .link_file_trunc("sync_stream.log")
+                            .lock();
+    auto &sync_fmt =
+        mlog::create_logger("sync_fmt").link_file_trunc("sync_fmt.log").lock();
+    auto &async_stream = mlog::create_logger("async_stream")
+                             .link_file_trunc("async_stream.log")
+                             .enable_async(1 << 16)
+                             .lock();
+    auto &async_fmt = mlog::create_logger("async_fmt")
+                          .link_file_trunc("async_fmt.log")
+                          .enable_async(1 << 16)
+                          .lock();
+
+    // 同样的输出内容：operator<<链式调用 vs 格式字符串
+    auto t1 = measure([](int i) {
+        mlog::info("sync_stream") << " i = " << i << ", x = " << i * 0.25
+                                  << ", y = " << i * 3 << '\n';
+    });
+    sync_stream.flush();
+
+    auto t2 = measure([&sync_fmt](int i) {
+        sync_fmt.info_fmt("i = {}, x = {}, y = {}", i, i * 0.25, i * 3);
+    });
+    sync_fmt.flush();
+
+    auto t3 = measure([](int i) {
+        mlog::info("async_stream") << " i = " << i << ", x = " << i * 0.25
+                                   << ", y = " << i * 3 << '\n';
+    });
+    async_stream.flush();
+
+    auto t4 = measure([&async_fmt](int i) {
+        async_fmt.info_fmt("i = {}, x = {}, y = {}", i, i * 0.25, i * 3);
+    });
+    async_fmt.flush();
+
+    report("sync, operator<<", t1);
+    report("sync, info_fmt", t2);
+    report("async, operator<<", t3);
+    report("async, info_fmt (deferred)", t4);
+
+    return 0;
+}
@@ -0,0 +1,54 @@
+#include "allay/mlog/mlog.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+namespace {
+
+constexpr int record_num = 1000000;
+
+template <typename Func>
+double measure(Func &&func) {
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < record_num; ++i) { func(i); }
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - begin).count()
+           / record_num;
+}
+
+void report(const char *name, double ns_per_record) {
+    std::printf("%-34s time/statement = %8.1f ns\n", name, ns_per_record);
+}
+
+}  // namespace
+
+// 比较按名称查找logger和使用缓存的句柄时每条语句的开销
+// logger对接到link_none，记录照常格式化但不写出，只比较调用方的开销
+int main() {
+    mlog::init();
+    mlog::set_level_info();
+
+    // 注册一些其它的logger，使得查找的表不是太小
+    for (int i = 0; i < 100; ++i) {
+        mlog::create_logger("logger_" + std::to_string(i)).link_none();
+    }
+    MLogHandle bench = mlog::create_logger("bench").link_none();
+    MLogHandle quiet =
+        mlog::create_logger("quiet").link_none().set_level(mlog::Level::warn);
+
+    auto t1 = measure([](int i) { mlog::info("bench") << " i = " << i << '\n'; });
+    auto t2 = measure([bench](int i) { bench.info() << " i = " << i << '\n'; });
+    auto t3 = measure([](int i) { MLOG_INFO("quiet") << " i = " << i << '\n'; });
+    auto t4 = measure([quiet](int i) { MLOG_INFO(quiet) << " i = " << i << '\n'; });
+    auto t5 = measure([](int i) { MLOG_DEBUG("bench") << " i = " << i << '\n'; });
+
+    report("mlog::info(\"name\")", t1);
+    report("handle.info()", t2);
+    report("MLOG_INFO(\"name\"), logger level", t3);
+    report("MLOG_INFO(handle), logger level", t4);
+    report("MLOG_DEBUG(\"name\"), global level", t5);
+
+    return 0;
+}
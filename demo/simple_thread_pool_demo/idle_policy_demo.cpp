@@ -0,0 +1,120 @@
+#include "allay/simple_thread_pool/simple_thread_pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+namespace {
+
+using Mode = SimpleThreadPool::Mode;
+using IdlePolicy = SimpleThreadPool::IdlePolicy;
+
+constexpr int round_num = 2000;
+
+int failed_num = 0;
+
+const char *mode_name(Mode mode) {
+    return mode == Mode::SHARED_QUEUE ? "shared_queue" : "work_stealing";
+}
+
+void check(bool condition, const char *name, Mode mode) {
+    if (condition) { return; }
+    ++failed_num;
+    std::printf("FAILED: %s (%s)\n", name, mode_name(mode));
+}
+
+// 每次只提交一个任务，等它结束后再提交下一个，线程池在两次提交之间总是空闲
+// gap为两次提交之间的间隔
+double ping_pong(SimpleThreadPool &pool, std::chrono::microseconds gap) {
+    std::atomic<int> done_num{0};
+
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 1; i <= round_num; ++i) {
+        pool.post([&] { done_num.fetch_add(1, std::memory_order_release); });
+        while (done_num.load(std::memory_order_acquire) < i) {
+            std::this_thread::yield();
+        }
+        if (gap.count() > 0) { std::this_thread::sleep_for(gap); }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::micro>(end - begin).count()
+           / round_num;
+}
+
+void print(const char *name, Mode mode, double round_us,
+           const SimpleThreadPool::WakeupStats &stats) {
+    std::printf("%-14s %-6s round %7.2f us, spin %5llu (avg %8.2f us), "
+                "park %5llu (avg %8.2f us)\n",
+                mode_name(mode), name, round_us,
+                static_cast<unsigned long long>(stats.spin_num),
+                stats.average_spin_ns() / 1000,
+                static_cast<unsigned long long>(stats.park_num),
+                stats.average_park_ns() / 1000);
+}
+
+void run(Mode mode) {
+    const IdlePolicy spin_policy{std::chrono::microseconds{20},
+                                 std::chrono::microseconds{200}};
+
+    // 默认直接睡眠，每个任务都要唤醒线程
+    {
+        SimpleThreadPool pool{1, mode};
+        const double round_us = ping_pong(pool, std::chrono::microseconds{0});
+        const auto stats = pool.get_wakeup_stats();
+        check(stats.spin_num == 0 && stats.park_num > 0, "park", mode);
+        print("park", mode, round_us, stats);
+    }
+
+    // 先自旋，紧接着提交的任务在自旋期间被拿到
+    {
+        SimpleThreadPool pool{1, mode, spin_policy};
+        const double round_us = ping_pong(pool, std::chrono::microseconds{0});
+        const auto stats = pool.get_wakeup_stats();
+        check(stats.spin_num > 0, "spin", mode);
+        print("spin", mode, round_us, stats);
+
+        // 间隔超过自旋时间，线程仍然会睡眠
+        pool.reset_wakeup_stats();
+        for (int i = 0; i < 20; ++i) {
+            pool.commit([] {}).get();
+            std::this_thread::sleep_for(std::chrono::milliseconds{2});
+        }
+        check(pool.get_wakeup_stats().park_num > 0, "spin then park", mode);
+
+        // 运行时切换回直接睡眠
+        pool.set_idle_policy({});
+        check(pool.get_idle_policy().spin_time.count() == 0, "set policy",
+              mode);
+        pool.commit([] {}).get();
+    }
+
+    // 多个线程自旋时析构不会被拖住
+    {
+        const IdlePolicy long_policy{std::chrono::seconds{1},
+                                     std::chrono::seconds{1}};
+        auto pool = std::make_unique<SimpleThreadPool>(4, mode, long_policy);
+        for (int i = 0; i < 10; ++i) { pool->commit([] {}).get(); }
+
+        auto begin = std::chrono::steady_clock::now();
+        pool.reset();
+        auto end = std::chrono::steady_clock::now();
+        check(end - begin < std::chrono::milliseconds{900}, "stop", mode);
+    }
+}
+
+}  // namespace
+
+int main() {
+    run(Mode::SHARED_QUEUE);
+    run(Mode::WORK_STEALING);
+
+    if (failed_num > 0) {
+        std::printf("%d checks failed\n", failed_num);
+        return 1;
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,92 @@
+#include "allay/simple_thread_pool/numa_thread_pool.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <future>
+#include <vector>
+
+namespace {
+
+int failed_num = 0;
+
+void check(bool condition, const char *name) {
+    if (condition) { return; }
+    ++failed_num;
+    std::printf("FAILED: %s\n", name);
+}
+
+void check_parse() {
+    using List = std::vector<std::uint32_t>;
+    check(CpuTopology::parse_cpu_list("0-3,8,10-11")
+              == List{0, 1, 2, 3, 8, 10, 11},
+          "parse ranges");
+    check(CpuTopology::parse_cpu_list("5") == List{5}, "parse single");
+    check(CpuTopology::parse_cpu_list("").empty(), "parse empty");
+    check(CpuTopology::parse_cpu_list("3-1").empty(), "parse bad range");
+    check(CpuTopology::parse_cpu_list("a,1").empty(), "parse garbage");
+}
+
+// 每个节点提交一批任务，检查它们在所在节点的CPU上运行
+void check_node_pools() {
+    NumaThreadPool pool{2};
+    const CpuTopology &topology = pool.get_topology();
+
+    std::printf("%zu node(s), pinned: %s\n", pool.get_node_num(),
+                pool.is_pinned() ? "yes" : "no");
+    for (const auto &node : topology.get_nodes()) {
+        std::printf("  node %u: %zu cpu(s)\n", node.id, node.cpus.size());
+    }
+
+    std::atomic<int> wrong_node_num{0};
+    std::vector<std::future<std::size_t>> results;
+    for (std::size_t node = 0; node < pool.get_node_num(); ++node) {
+        for (std::size_t i = 0; i < 100; ++i) {
+            results.push_back(pool.commit_on(node, [&, node, i] {
+                if (pool.is_pinned() && topology.current_node() != node) {
+                    ++wrong_node_num;
+                }
+                return i;
+            }));
+        }
+    }
+
+    std::size_t sum = 0;
+    for (auto &result : results) { sum += result.get(); }
+    check(sum == pool.get_node_num() * 4950, "node results");
+    check(wrong_node_num == 0, "node placement");
+
+    // 不指定节点时提交到调用线程所在的节点
+    check(pool.commit([] { return 1; }).get() == 1, "local commit");
+}
+
+// 单个线程池的每个线程绑定到一个核心
+void check_core_pinning() {
+    const CpuTopology topology = CpuTopology::detect();
+    std::vector<std::vector<std::uint32_t>> cores;
+    for (const auto &node : topology.get_nodes()) {
+        for (std::uint32_t cpu : node.cpus) { cores.push_back({cpu}); }
+    }
+
+    SimpleThreadPool pool{4};
+    const bool pinned = pool.set_affinity(cores);
+#if defined(__linux__)
+    check(pinned, "core pinning");
+#endif
+    check(pool.commit([] { return 2; }).get() == 2, "pinned commit");
+}
+
+}  // namespace
+
+int main() {
+    check_parse();
+    check_node_pools();
+    check_core_pinning();
+
+    if (failed_num > 0) {
+        std::printf("%d checks failed\n", failed_num);
+        return 1;
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,145 @@
+#include "allay/simple_thread_pool/parallel_algorithms.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <future>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Mode = SimpleThreadPool::Mode;
+
+int failed_num = 0;
+
+void check(bool condition, const char *name, Mode mode) {
+    if (condition) { return; }
+    ++failed_num;
+    std::printf("FAILED: %s (%s)\n", name,
+                mode == Mode::SHARED_QUEUE ? "shared_queue" : "work_stealing");
+}
+
+// 与标准库的串行算法比较结果
+void check_results(Mode mode) {
+    const uint32_t thread_num =
+        std::clamp(std::thread::hardware_concurrency(), 2U, 8U);
+    SimpleThreadPool pool{thread_num, mode};
+
+    for (std::size_t n : {0, 1, 2, 7, 100, 10007}) {
+        std::vector<std::int64_t> data(n);
+        std::iota(data.begin(), data.end(), 1);
+
+        std::vector<int> hits(n, 0);
+        parallel_for(pool, std::size_t{0}, n,
+                     [&](std::size_t i) { ++hits[i]; });
+        check(std::ranges::all_of(hits, [](int x) { return x == 1; }),
+              "parallel_for", mode);
+
+        check(parallel_reduce(pool, data.begin(), data.end(), std::int64_t{5})
+                  == std::reduce(data.begin(), data.end(), std::int64_t{5}),
+              "parallel_reduce", mode);
+
+        std::vector<std::int64_t> squares(n);
+        std::vector<std::int64_t> expected(n);
+        auto square = [](std::int64_t x) { return x * x; };
+        parallel_transform(pool, data.begin(), data.end(), squares.begin(),
+                           square);
+        std::transform(data.begin(), data.end(), expected.begin(), square);
+        check(squares == expected, "parallel_transform", mode);
+
+        std::inclusive_scan(data.begin(), data.end(), expected.begin());
+        std::vector<std::int64_t> scanned = data;
+        parallel_scan(pool, scanned.begin(), scanned.end(), scanned.begin(),
+                      std::plus<>{}, 3);
+        check(scanned == expected, "parallel_scan(in place)", mode);
+    }
+
+    // 不满足交换律的运算，检查合并顺序
+    std::vector<std::string> words(1000, "ab");
+    check(parallel_reduce(pool, words.begin(), words.end(), std::string{})
+              == std::accumulate(words.begin(), words.end(), std::string{}),
+          "parallel_reduce(string)", mode);
+
+    // 在线程池的每一个线程中嵌套调用，调用线程自己也会执行，不会死锁
+    std::atomic<int> nested_sum{0};
+    std::vector<std::future<void>> results;
+    for (uint32_t t = 0; t < thread_num; ++t) {
+        results.push_back(pool.commit([&] {
+            parallel_for(pool, 0, 1000, [&](int i) {
+                nested_sum.fetch_add(i, std::memory_order_relaxed);
+            });
+        }));
+    }
+    for (auto &result : results) { result.get(); }
+    check(nested_sum == static_cast<int>(thread_num) * 499500,
+          "nested parallel_for", mode);
+
+    bool caught = false;
+    try {
+        parallel_for(pool, 0, 1000, 1, [](int i) {
+            if (i == 500) { throw std::runtime_error("500"); }
+        });
+    }
+    catch (const std::runtime_error &) {
+        caught = true;
+    }
+    check(caught, "parallel_for exception", mode);
+}
+
+volatile double sink = 0;
+
+double work(std::size_t i) { return std::sqrt(static_cast<double>(i)); }
+
+// 每个元素提交一个任务，与按块提交比较
+void compare_time(Mode mode) {
+    constexpr std::size_t n = 200000;
+    const uint32_t thread_num =
+        std::clamp(std::thread::hardware_concurrency(), 1U, 16U);
+    SimpleThreadPool pool{thread_num, mode};
+    std::vector<double> out(n);
+
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<std::future<void>> results;
+    results.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        results.push_back(pool.commit([&out, i] { out[i] = work(i); }));
+    }
+    for (auto &result : results) { result.get(); }
+    auto middle = std::chrono::steady_clock::now();
+
+    parallel_for(pool, std::size_t{0}, n,
+                 [&](std::size_t i) { out[i] = work(i); });
+    auto end = std::chrono::steady_clock::now();
+    sink = out[n - 1];
+
+    std::printf(
+        "%-14s threads %2u: commit per element %8.1f ns/element, "
+        "parallel_for %6.1f ns/element\n",
+        mode == Mode::SHARED_QUEUE ? "shared_queue" : "work_stealing",
+        thread_num,
+        std::chrono::duration<double, std::nano>(middle - begin).count() / n,
+        std::chrono::duration<double, std::nano>(end - middle).count() / n);
+}
+
+}  // namespace
+
+int main() {
+    for (Mode mode : {Mode::SHARED_QUEUE, Mode::WORK_STEALING}) {
+        check_results(mode);
+        compare_time(mode);
+    }
+
+    if (failed_num > 0) {
+        std::printf("%d checks failed\n", failed_num);
+        return 1;
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}
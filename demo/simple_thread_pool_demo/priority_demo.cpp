@@ -0,0 +1,160 @@
+#include "allay/simple_thread_pool/simple_thread_pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Mode = SimpleThreadPool::Mode;
+using Priority = SimpleThreadPool::Priority;
+using Clock = SimpleThreadPool::Clock;
+
+int failed_num = 0;
+
+const char *mode_name(Mode mode) {
+    return mode == Mode::SHARED_QUEUE ? "shared_queue" : "work_stealing";
+}
+
+void check(bool condition, const char *name, Mode mode) {
+    if (condition) { return; }
+    ++failed_num;
+    std::printf("FAILED: %s (%s)\n", name, mode_name(mode));
+}
+
+// 唯一的线程被阻塞时提交各种任务，放行以后检查执行顺序
+void check_order(Mode mode) {
+    SimpleThreadPool pool{1, mode};
+    std::promise<void> gate;
+    std::shared_future<void> opened = gate.get_future().share();
+    std::atomic_bool blocked{false};
+    pool.post([&] {
+        blocked = true;
+        opened.wait();
+    });
+    while (!blocked) { std::this_thread::yield(); }
+
+    std::mutex mtx;
+    std::string order;
+    auto record = [&](char name) {
+        return [&, name] {
+            std::lock_guard<std::mutex> lock(mtx);
+            order += name;
+        };
+    };
+
+    const auto now = Clock::now();
+    const auto later = now + std::chrono::hours{1};
+    pool.post(Priority::LOW, record('l'));
+    pool.post(record('a'));
+    pool.post(record('b'));
+    pool.post({Priority::NORMAL, later + std::chrono::minutes{1}}, record('e'));
+    pool.post({Priority::NORMAL, later}, record('d'));
+    pool.post(Priority::HIGH, record('h'));
+    // 已经超过截止时间，不论优先级最先执行
+    pool.post({Priority::LOW, now - std::chrono::seconds{1}}, record('o'));
+    auto last = pool.commit(Priority::LOW, record('z'));
+
+    gate.set_value();
+    last.get();
+    check(order == "ohdeablz", "execution order", mode);
+    if (order != "ohdeablz") { std::printf("order: %s\n", order.c_str()); }
+
+    const auto low = pool.get_queue_stats(Priority::LOW);
+    check(low.task_num == 3 && low.deadline_missed == 1, "low stats", mode);
+}
+
+// 工作窃取模式下，全局队列中的任务到达截止时间以后先于本地队列中的任务执行，
+// 没有到达截止时间的任务排在本地队列(后进先出)之后
+void check_overdue_injected() {
+    const Mode mode = Mode::WORK_STEALING;
+    SimpleThreadPool pool{1, mode};
+
+    std::mutex mtx;
+    std::string order;
+    auto record = [&](char name) {
+        return [&, name] {
+            std::lock_guard<std::mutex> lock(mtx);
+            order += name;
+        };
+    };
+
+    std::promise<void> gate;
+    std::shared_future<void> opened = gate.get_future().share();
+    std::atomic_bool blocked{false};
+    pool.post([&] {
+        pool.post(record('a'));
+        pool.post(record('b'));
+        blocked = true;
+        opened.wait();
+    });
+    while (!blocked) { std::this_thread::yield(); }
+
+    const auto now = Clock::now();
+    pool.post({Priority::NORMAL, now + std::chrono::hours{1}}, record('e'));
+    pool.post({Priority::NORMAL, now + std::chrono::milliseconds{10}},
+              record('d'));
+    std::this_thread::sleep_for(std::chrono::milliseconds{20});
+
+    gate.set_value();
+    pool.drain();
+    check(order == "dbae", "overdue injected", mode);
+    if (order != "dbae") { std::printf("order: %s\n", order.c_str()); }
+}
+
+volatile double sink = 0;
+
+void batch_work() {
+    double x = 0;
+    for (int i = 1; i < 2000; ++i) { x += std::sqrt(static_cast<double>(i)); }
+    sink = x;
+}
+
+// 大量的批处理任务中夹杂少量延迟敏感的任务，比较两者的排队延迟
+void compare_latency(Mode mode) {
+    SimpleThreadPool pool{2, mode};
+    constexpr int batch_num = 20000;
+
+    std::vector<std::future<void>> results;
+    results.reserve(batch_num + batch_num / 100);
+    for (int i = 0; i < batch_num; ++i) {
+        results.push_back(pool.commit(Priority::LOW, batch_work));
+        if (i % 100 == 0) {
+            results.push_back(pool.commit(Priority::HIGH, batch_work));
+        }
+    }
+    for (auto &result : results) { result.get(); }
+
+    const auto high = pool.get_queue_stats(Priority::HIGH);
+    const auto low = pool.get_queue_stats(Priority::LOW);
+    check(high.average_wait_ns() < low.average_wait_ns(), "latency", mode);
+    std::printf("%-14s HIGH avg wait %10.1f us (max %8.1f us), "
+                "LOW avg wait %10.1f us (max %8.1f us)\n",
+                mode_name(mode), high.average_wait_ns() / 1000,
+                static_cast<double>(high.max_wait_ns) / 1000,
+                low.average_wait_ns() / 1000,
+                static_cast<double>(low.max_wait_ns) / 1000);
+}
+
+}  // namespace
+
+int main() {
+    for (Mode mode : {Mode::SHARED_QUEUE, Mode::WORK_STEALING}) {
+        check_order(mode);
+        compare_latency(mode);
+    }
+    check_overdue_injected();
+
+    if (failed_num > 0) {
+        std::printf("%d checks failed\n", failed_num);
+        return 1;
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}
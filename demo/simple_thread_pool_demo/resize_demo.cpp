@@ -0,0 +1,258 @@
+#include "allay/simple_thread_pool/simple_thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Mode = SimpleThreadPool::Mode;
+using namespace std::chrono_literals;
+
+int failed_num = 0;
+
+const char *mode_name(Mode mode) {
+    return mode == Mode::SHARED_QUEUE ? "shared_queue" : "work_stealing";
+}
+
+void check(bool condition, const char *name, Mode mode) {
+    if (condition) { return; }
+    ++failed_num;
+    std::printf("FAILED: %s (%s)\n", name, mode_name(mode));
+}
+
+// 等待条件成立，最多等待2秒
+template <typename Pred>
+bool wait_until(Pred pred) {
+    const auto deadline = std::chrono::steady_clock::now() + 2s;
+    while (!pred()) {
+        if (std::chrono::steady_clock::now() > deadline) { return false; }
+        std::this_thread::sleep_for(1ms);
+    }
+    return true;
+}
+
+// 记录同时执行的任务数的最大值
+struct Concurrency {
+    std::atomic<int> running{0};
+    std::atomic<int> max_running{0};
+
+    void run(std::chrono::microseconds duration) {
+        const int now = ++running;
+        int max_now = max_running.load();
+        while (now > max_now
+               && !max_running.compare_exchange_weak(max_now, now)) {}
+        std::this_thread::sleep_for(duration);
+        --running;
+    }
+};
+
+// 同时阻塞thread_num个任务，只有线程数足够时才能全部开始
+bool run_together(SimpleThreadPool &pool, int task_num) {
+    std::atomic<int> started{0};
+    std::vector<std::future<void>> results;
+    for (int i = 0; i < task_num; ++i) {
+        results.push_back(pool.commit([&] {
+            ++started;
+            wait_until([&] { return started.load() >= task_num; });
+        }));
+        // 等这个任务开始以后再提交下一个，弹性伸缩按照繁忙的线程增加线程
+        wait_until([&] { return started.load() > i; });
+    }
+    for (auto &result : results) { result.get(); }
+    return started.load() == task_num;
+}
+
+void check_resize(Mode mode) {
+    SimpleThreadPool pool{1, mode};
+
+    pool.resize(4);
+    check(pool.get_thread_num() == 4, "grow thread num", mode);
+    check(run_together(pool, 4), "grow concurrency", mode);
+
+    // 有任务排队时缩小，任务不会丢失
+    std::atomic<int> done_num{0};
+    std::vector<std::future<void>> results;
+    for (int i = 0; i < 2000; ++i) {
+        results.push_back(pool.commit([&] { ++done_num; }));
+        if (i == 1000) { pool.resize(1); }
+    }
+    for (auto &result : results) { result.get(); }
+    check(done_num == 2000, "shrink keeps tasks", mode);
+    check(pool.get_thread_num() == 1, "shrink thread num", mode);
+
+    // 缩小以后只有一个线程执行任务
+    Concurrency concurrency;
+    results.clear();
+    for (int i = 0; i < 8; ++i) {
+        results.push_back(pool.commit([&] { concurrency.run(2ms); }));
+    }
+    for (auto &result : results) { result.get(); }
+    check(concurrency.max_running == 1, "shrink concurrency", mode);
+
+    // 再次增加
+    pool.resize(3);
+    check(run_together(pool, 3), "grow again", mode);
+}
+
+void check_drain(Mode mode) {
+    SimpleThreadPool pool{2, mode};
+
+    std::atomic<int> done_num{0};
+    std::atomic<int> child_num{0};
+    std::vector<std::future<void>> results;
+    for (int i = 0; i < 200; ++i) {
+        results.push_back(pool.commit([&] {
+            std::this_thread::sleep_for(50us);
+            ++done_num;
+            // 关闭过程中仍然可以提交后续任务
+            pool.post([&] { ++child_num; });
+        }));
+    }
+    pool.drain();
+
+    check(done_num == 200 && child_num == 200, "drain runs all", mode);
+    bool all_ready = std::all_of(results.begin(), results.end(),
+                                 [](std::future<void> &result) {
+                                     return result.wait_for(0s)
+                                            == std::future_status::ready;
+                                 });
+    check(all_ready, "drain futures", mode);
+    check(!pool.is_running(), "drain stopped", mode);
+
+    bool rejected = false;
+    try {
+        pool.post([] {});
+    }
+    catch (const std::runtime_error &) {
+        rejected = true;
+    }
+    check(rejected, "drain rejects", mode);
+}
+
+void check_cancel(Mode mode) {
+    SimpleThreadPool pool{1, mode};
+
+    // 唯一的线程阻塞到开始关闭
+    std::atomic_bool blocked{false};
+    pool.post([&] {
+        blocked = true;
+        wait_until([&pool] { return !pool.is_running(); });
+        std::this_thread::sleep_for(20ms);
+    });
+    wait_until([&] { return blocked.load(); });
+
+    std::atomic<int> done_num{0};
+    std::vector<std::future<void>> results;
+    for (int i = 0; i < 10; ++i) {
+        results.push_back(pool.commit([&] { ++done_num; }));
+    }
+
+    const std::size_t discarded_num = pool.cancel();
+    int broken_num = 0;
+    for (auto &result : results) {
+        try {
+            result.get();
+        }
+        catch (const std::future_error &) {
+            ++broken_num;
+        }
+    }
+    check(static_cast<int>(discarded_num) == broken_num, "cancel count", mode);
+    check(broken_num + done_num == 10, "cancel futures", mode);
+    check(discarded_num > 0, "cancel discards", mode);
+    pool.drain();  // 已经关闭，没有效果
+}
+
+void check_elastic(Mode mode) {
+    SimpleThreadPool pool{1, mode};
+    pool.set_elastic_policy({1, 4, 50ms});
+
+    check(run_together(pool, 4), "elastic grow", mode);
+    check(pool.get_thread_num() == 4, "elastic max", mode);
+
+    // 空闲超时以后回到下限
+    check(wait_until([&] { return pool.get_thread_num() == 1; }),
+          "elastic shrink", mode);
+    check(pool.commit([] { return 1; }).get() == 1, "elastic commit", mode);
+}
+
+// 析构时执行完所有排队的任务
+void check_destructor(Mode mode) {
+    std::atomic<int> done_num{0};
+    {
+        SimpleThreadPool pool{2, mode};
+        for (int i = 0; i < 100; ++i) {
+            pool.post([&] {
+                std::this_thread::sleep_for(50us);
+                ++done_num;
+            });
+        }
+    }
+    check(done_num == 100, "destructor drains", mode);
+}
+
+// 关闭过程中任务仍然可以调用控制接口，resize()抛出异常而不是死锁
+void check_control_in_drain(Mode mode) {
+    SimpleThreadPool pool{2, mode};
+
+    std::atomic_bool resize_rejected{false};
+    pool.post([&] {
+        wait_until([&] { return !pool.is_running(); });
+        pool.set_affinity({});
+        try {
+            pool.resize(3);
+        }
+        catch (const std::runtime_error &) {
+            resize_rejected = true;
+        }
+    });
+    pool.drain();
+    check(resize_rejected, "control in drain", mode);
+}
+
+// 在线程池自己的任务中析构，不合并当前线程
+void check_destroy_in_worker(Mode mode) {
+    auto pool = std::make_unique<SimpleThreadPool>(2, mode);
+    std::atomic_bool posted{false};
+    std::atomic_bool destroyed{false};
+    for (int i = 0; i < 100; ++i) {
+        pool->post([] { std::this_thread::sleep_for(50us); });
+    }
+    // 等post()返回以后再析构，外部线程不再使用这个线程池
+    pool->post([&] {
+        wait_until([&] { return posted.load(); });
+        pool.reset();
+        destroyed = true;
+    });
+    posted = true;
+    check(wait_until([&] { return destroyed.load(); }), "destroy in worker",
+          mode);
+}
+
+}  // namespace
+
+int main() {
+    for (Mode mode : {Mode::SHARED_QUEUE, Mode::WORK_STEALING}) {
+        check_resize(mode);
+        check_drain(mode);
+        check_cancel(mode);
+        check_elastic(mode);
+        check_destructor(mode);
+        check_control_in_drain(mode);
+        check_destroy_in_worker(mode);
+    }
+
+    if (failed_num > 0) {
+        std::printf("%d checks failed\n", failed_num);
+        return 1;
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}
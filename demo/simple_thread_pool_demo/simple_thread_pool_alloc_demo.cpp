@@ -0,0 +1,121 @@
+#include "allay/simple_thread_pool/simple_thread_pool.hpp"
+#include "../common/alloc_counter.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <future>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Mode = SimpleThreadPool::Mode;
+
+constexpr int task_num = 256 * 80;
+// 每一轮提交的任务数，等待完成后再提交下一轮，使内存池的用量稳定
+constexpr int round_size = 256;
+
+std::atomic<int> done_num{0};
+
+// 早于内存池构造，晚于内存池和主线程的缓存析构，
+// 程序退出时其中的共享状态直接交给operator delete
+std::vector<std::future<int>> exit_results;
+
+void wait_done(int target) {
+    while (done_num.load(std::memory_order_acquire) < target) {
+        std::this_thread::yield();
+    }
+}
+
+struct Result {
+    double allocs_per_task;
+    double ns_per_task;
+};
+
+// 同样的任务先完整地运行一遍，让内存池和容器达到稳定的大小
+template <typename Func>
+Result measure(Func &&func) {
+    func();
+
+    const std::size_t alloc_begin = demo::alloc_count.load();
+    auto begin = std::chrono::steady_clock::now();
+    func();
+    auto end = std::chrono::steady_clock::now();
+    const std::size_t alloc_end = demo::alloc_count.load();
+
+    return Result{
+        static_cast<double>(alloc_end - alloc_begin) / task_num,
+        std::chrono::duration<double, std::nano>(end - begin).count()
+            / task_num};
+}
+
+void report(const char *name, Mode mode, const Result &result) {
+    std::printf("%-28s %-14s allocs/task = %6.3f, time/task = %8.1f ns\n",
+                name,
+                mode == Mode::SHARED_QUEUE ? "shared_queue" : "work_stealing",
+                result.allocs_per_task, result.ns_per_task);
+}
+
+void run(Mode mode) {
+    SimpleThreadPool pool{2, mode};
+    std::vector<std::future<int>> results;
+    results.reserve(round_size);
+
+    const auto commit_small = [&] {
+        for (int i = 0; i < task_num; i += round_size) {
+            for (int j = 0; j < round_size; ++j) {
+                results.push_back(pool.commit([j] { return j; }));
+            }
+            for (auto &result : results) { result.get(); }
+            results.clear();
+        }
+    };
+
+    const auto post_small = [&] {
+        done_num = 0;
+        for (int i = 0; i < task_num; i += round_size) {
+            for (int j = 0; j < round_size; ++j) {
+                pool.post(
+                    [] { done_num.fetch_add(1, std::memory_order_release); });
+            }
+            wait_done(i + round_size);
+        }
+    };
+
+    // 超过任务内部缓冲区的可调用对象，需要单独分配
+    const auto post_large = [&] {
+        done_num = 0;
+        std::array<char, 128> payload{};
+        for (int i = 0; i < task_num; i += round_size) {
+            for (int j = 0; j < round_size; ++j) {
+                pool.post([payload] {
+                    done_num.fetch_add(payload[0] + 1,
+                                       std::memory_order_release);
+                });
+            }
+            wait_done(i + round_size);
+        }
+    };
+
+    report("commit(small closure)", mode, measure(commit_small));
+    report("post(small closure)", mode, measure(post_small));
+    report("post(128-byte closure)", mode, measure(post_large));
+
+    for (int i = 0; i < round_size; ++i) {
+        exit_results.push_back(pool.commit([i] { return i; }));
+    }
+    for (auto &result : exit_results) { result.wait(); }
+}
+
+}  // namespace
+
+// 提交较小的任务时，任务节点和future的共享状态都来自内存池，
+// 稳定运行时每个任务的分配次数应当接近0
+int main() {
+    run(Mode::SHARED_QUEUE);
+    run(Mode::WORK_STEALING);
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include "allay/simple_thread_pool/simple_thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Mode = SimpleThreadPool::Mode;
+
+constexpr int tiny_task_num = 20000;
+constexpr int medium_task_num = 2000;
+constexpr int nested_root_num = 20;
+constexpr int bulk_task_num = 100000;
+
+std::atomic<int> done_num{0};
+volatile double sink = 0;
+
+void tiny_task() { done_num.fetch_add(1, std::memory_order_relaxed); }
+
+// 几微秒的计算
+void medium_task() {
+    double x = 0;
+    for (int i = 1; i < 2000; ++i) { x += std::sqrt(static_cast<double>(i)); }
+    sink = x;
+    done_num.fetch_add(1, std::memory_order_relaxed);
+}
+
+void wait_done(int target) {
+    while (done_num.load(std::memory_order_acquire) < target) {
+        std::this_thread::yield();
+    }
+}
+
+// 外部线程逐个提交
+template <typename Func>
+double run_flat(uint32_t thread_num, Mode mode, int task_num, Func func) {
+    SimpleThreadPool pool{thread_num, mode};
+    done_num = 0;
+
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < task_num; ++i) { pool.commit(func); }
+    wait_done(task_num);
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - begin).count()
+           / task_num;
+}
+
+// 少数根任务在线程池内部提交大量子任务
+double run_nested(uint32_t thread_num, Mode mode) {
+    SimpleThreadPool pool{thread_num, mode};
+    done_num = 0;
+    constexpr int child_num = tiny_task_num / nested_root_num;
+
+    auto begin = std::chrono::steady_clock::now();
+    for (int r = 0; r < nested_root_num; ++r) {
+        pool.commit([&pool] {
+            for (int i = 0; i < child_num; ++i) { pool.commit(tiny_task); }
+        });
+    }
+    wait_done(nested_root_num * child_num);
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - begin).count()
+           / (nested_root_num * child_num);
+}
+
+struct SubmitResult {
+    double enqueue_ns;  // 每个任务的提交耗时
+    double total_ns;    // 每个任务的提交和执行耗时
+};
+
+// 外部线程提交大量空任务，逐个commit或者一次commit_bulk
+SubmitResult run_submit(uint32_t thread_num, Mode mode, bool bulk) {
+    SimpleThreadPool pool{thread_num, mode};
+    done_num = 0;
+    const std::vector<void (*)()> tasks(bulk_task_num, tiny_task);
+
+    auto begin = std::chrono::steady_clock::now();
+    if (bulk) { pool.commit_bulk(tasks); }
+    else {
+        for (auto task : tasks) { pool.commit(task); }
+    }
+    auto enqueued = std::chrono::steady_clock::now();
+    wait_done(bulk_task_num);
+    auto end = std::chrono::steady_clock::now();
+
+    return SubmitResult{
+        std::chrono::duration<double, std::nano>(enqueued - begin).count()
+            / bulk_task_num,
+        std::chrono::duration<double, std::nano>(end - begin).count()
+            / bulk_task_num};
+}
+
+}  // namespace
+
+// 比较两种调度方式在不同线程数下每个任务的平均耗时(包括提交和执行)
+// 以及逐个commit与commit_bulk的提交耗时
+// tiny: 几乎为空的任务，主要是调度的开销；medium: 几微秒的计算
+// nested: 任务在线程池内部提交子任务，工作窃取模式下放入本地队列
+int main() {
+    const uint32_t max_thread_num =
+        std::clamp(std::thread::hardware_concurrency(), 1U, 16U);
+
+    std::printf("%-14s %7s %12s %12s %12s\n", "mode", "threads",
+                "tiny(ns)", "medium(ns)", "nested(ns)");
+    for (uint32_t n = 1; n <= max_thread_num; n *= 2) {
+        for (Mode mode : {Mode::SHARED_QUEUE, Mode::WORK_STEALING}) {
+            const double tiny = run_flat(n, mode, tiny_task_num, tiny_task);
+            const double medium =
+                run_flat(n, mode, medium_task_num, medium_task);
+            const double nested = run_nested(n, mode);
+            std::printf("%-14s %7u %12.1f %12.1f %12.1f\n",
+                        mode == Mode::SHARED_QUEUE ? "shared_queue"
+                                                   : "work_stealing",
+                        n, tiny, medium, nested);
+        }
+    }
+
+    // 逐个提交与批量提交的比较
+    // 先运行一次，让内存池中有足够多的任务节点，避免第一次批量提交时的分配
+    run_submit(1, Mode::SHARED_QUEUE, true);
+    std::printf("\n%-14s %7s %14s %14s %14s %14s\n", "mode", "threads",
+                "commit enq(ns)", "commit all(ns)", "bulk enq(ns)",
+                "bulk all(ns)");
+    for (uint32_t n = 1; n <= max_thread_num; n *= 2) {
+        for (Mode mode : {Mode::SHARED_QUEUE, Mode::WORK_STEALING}) {
+            const SubmitResult single = run_submit(n, mode, false);
+            const SubmitResult bulk = run_submit(n, mode, true);
+            std::printf("%-14s %7u %14.1f %14.1f %14.1f %14.1f\n",
+                        mode == Mode::SHARED_QUEUE ? "shared_queue"
+                                                   : "work_stealing",
+                        n, single.enqueue_ns, single.total_ns, bulk.enqueue_ns,
+                        bulk.total_ns);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,158 @@
+#include "allay/simple_thread_pool/task_graph.hpp"
+#include "../common/alloc_counter.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Mode = SimpleThreadPool::Mode;
+
+constexpr int stage_num = 4;
+constexpr int width = 8;
+constexpr int run_num = 1000;
+constexpr int warmup_run_num = 500;  // 内存池的用量稳定以后再统计分配
+
+int failed_num = 0;
+
+const char *mode_name(Mode mode) {
+    return mode == Mode::SHARED_QUEUE ? "shared_queue" : "work_stealing";
+}
+
+void check(bool condition, const char *name, Mode mode) {
+    if (condition) { return; }
+    ++failed_num;
+    std::printf("FAILED: %s (%s)\n", name, mode_name(mode));
+}
+
+volatile double sink = 0;
+
+void work() {
+    double x = 0;
+    for (int i = 1; i < 500; ++i) { x += std::sqrt(static_cast<double>(i)); }
+    sink = x;
+}
+
+// 多阶段的流水线，每一个阶段的每一个任务依赖上一个阶段的所有任务
+// 每个任务检查它的前驱在本次运行中都已经结束
+void run(Mode mode) {
+    const uint32_t thread_num =
+        std::clamp(std::thread::hardware_concurrency(), 2U, 8U);
+    SimpleThreadPool pool{thread_num, mode};
+
+    std::vector<std::atomic<int>> finished_run(stage_num * width);
+    std::atomic<int> current_run{0};
+    std::atomic<bool> order_ok{true};
+
+    TaskGraph graph;
+    std::vector<TaskGraph::NodeId> previous;
+    for (int s = 0; s < stage_num; ++s) {
+        std::vector<TaskGraph::NodeId> stage;
+        for (int w = 0; w < width; ++w) {
+            const int index = s * width + w;
+            auto task = [&, s, index] {
+                const int run = current_run.load();
+                for (int p = 0; s > 0 && p < width; ++p) {
+                    if (finished_run[(s - 1) * width + p].load() != run) {
+                        order_ok = false;
+                    }
+                }
+                work();
+                finished_run[index].store(run);
+            };
+
+            stage.push_back(graph.add(task));
+            for (TaskGraph::NodeId p : previous) {
+                graph.precede(p, stage.back());
+            }
+        }
+        previous = stage;
+    }
+    graph.run(pool);
+
+    std::size_t alloc_begin = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int r = 1; r <= run_num; ++r) {
+        if (r == warmup_run_num + 1) { alloc_begin = demo::alloc_count.load(); }
+        current_run = r;
+        graph.run(pool);
+    }
+    auto end = std::chrono::steady_clock::now();
+    const std::size_t alloc_end = demo::alloc_count.load();
+    check(order_ok, "dependency order", mode);
+
+    // 同样的流水线，用future在阶段之间等待
+    auto future_begin = std::chrono::steady_clock::now();
+    std::vector<std::future<void>> results;
+    for (int r = 0; r < run_num; ++r) {
+        for (int s = 0; s < stage_num; ++s) {
+            for (int w = 0; w < width; ++w) {
+                results.push_back(pool.commit(work));
+            }
+            for (auto &result : results) { result.get(); }
+            results.clear();
+        }
+    }
+    auto future_end = std::chrono::steady_clock::now();
+
+    // 抛出异常的节点的后继被跳过
+    bool caught = false;
+    bool skipped = true;
+    TaskGraph failing;
+    const auto first = failing.add([] { throw std::runtime_error("first"); });
+    failing.add([&] { skipped = false; }, {first});
+    try {
+        failing.run(pool);
+    }
+    catch (const std::runtime_error &) {
+        caught = true;
+    }
+    check(caught && skipped, "exception", mode);
+
+    // 线程池停止以后提交失败，run结束并重新抛出提交时的异常
+    pool.drain();
+    bool rejected = false;
+    bool ran = false;
+    TaskGraph late;
+    late.add([&] { ran = true; });
+    try {
+        late.run(pool);
+    }
+    catch (const std::runtime_error &) {
+        rejected = true;
+    }
+    check(rejected && !ran, "stopped pool", mode);
+
+    std::printf("%-14s graph %8.1f us/run (allocs/run %.3f), "
+                "futures %8.1f us/run\n",
+                mode_name(mode),
+                std::chrono::duration<double, std::micro>(end - begin).count()
+                    / run_num,
+                static_cast<double>(alloc_end - alloc_begin)
+                    / (run_num - warmup_run_num),
+                std::chrono::duration<double, std::micro>(future_end
+                                                          - future_begin)
+                        .count()
+                    / run_num);
+}
+
+}  // namespace
+
+int main() {
+    run(Mode::SHARED_QUEUE);
+    run(Mode::WORK_STEALING);
+
+    if (failed_num > 0) {
+        std::printf("%d checks failed\n", failed_num);
+        return 1;
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include "allay/simple_thread_pool/task_group.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <future>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+using Mode = SimpleThreadPool::Mode;
+
+int failed_num = 0;
+
+const char *mode_name(Mode mode) {
+    return mode == Mode::SHARED_QUEUE ? "shared_queue" : "work_stealing";
+}
+
+void check(bool condition, const char *name, Mode mode) {
+    if (condition) { return; }
+    ++failed_num;
+    std::printf("FAILED: %s (%s)\n", name, mode_name(mode));
+}
+
+// 递归的分治求和，每一层都在线程池的任务中创建TaskGroup并等待
+std::int64_t parallel_sum(SimpleThreadPool &pool, const std::int64_t *data,
+                          std::size_t n) {
+    if (n <= 1000) { return std::accumulate(data, data + n, std::int64_t{0}); }
+
+    std::int64_t left = 0;
+    std::int64_t right = 0;
+    TaskGroup group{pool};
+    group.run([&] { left = parallel_sum(pool, data, n / 2); });
+    group.run([&] { right = parallel_sum(pool, data + n / 2, n - n / 2); });
+    group.wait();
+    return left + right;
+}
+
+void run(Mode mode, uint32_t thread_num) {
+    SimpleThreadPool pool{thread_num, mode};
+    std::vector<std::int64_t> data(1 << 20);
+    std::iota(data.begin(), data.end(), 0);
+    const std::int64_t expected =
+        std::accumulate(data.begin(), data.end(), std::int64_t{0});
+
+    // 外部线程等待
+    auto begin = std::chrono::steady_clock::now();
+    check(parallel_sum(pool, data.data(), data.size()) == expected,
+          "recursive sum", mode);
+    auto end = std::chrono::steady_clock::now();
+
+    // 所有线程都被占用，每个线程都在等待自己的递归任务
+    std::vector<std::future<std::int64_t>> results;
+    for (uint32_t i = 0; i < thread_num; ++i) {
+        results.push_back(pool.commit(
+            [&] { return parallel_sum(pool, data.data(), data.size()); }));
+    }
+    for (auto &result : results) {
+        check(result.get() == expected, "recursive sum in busy pool", mode);
+    }
+
+    bool caught = false;
+    try {
+        TaskGroup group{pool};
+        for (int i = 0; i < 100; ++i) {
+            group.run([i] {
+                if (i == 50) { throw std::runtime_error("50"); }
+            });
+        }
+        group.wait();
+    }
+    catch (const std::runtime_error &) {
+        caught = true;
+    }
+    check(caught, "exception", mode);
+
+    std::printf("%-14s threads %2u: recursive sum %8.1f us\n", mode_name(mode),
+                thread_num,
+                std::chrono::duration<double, std::micro>(end - begin).count());
+}
+
+}  // namespace
+
+int main() {
+    for (Mode mode : {Mode::SHARED_QUEUE, Mode::WORK_STEALING}) {
+        for (uint32_t thread_num : {1U, 2U, 4U}) { run(mode, thread_num); }
+    }
+
+    if (failed_num > 0) {
+        std::printf("%d checks failed\n", failed_num);
+        return 1;
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,202 @@
+#include "allay/simple_thread_pool/simple_thread_pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <future>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Mode = SimpleThreadPool::Mode;
+using Histogram = SimpleThreadPool::Histogram;
+
+int failed_num = 0;
+
+const char *mode_name(Mode mode) {
+    return mode == Mode::SHARED_QUEUE ? "shared_queue" : "work_stealing";
+}
+
+void check(bool condition, const char *name, Mode mode) {
+    if (condition) { return; }
+    ++failed_num;
+    std::printf("FAILED: %s (%s)\n", name, mode_name(mode));
+}
+
+// 桶是连续的，每个值落在自己的桶内，桶宽不超过下界的1/16
+void check_buckets() {
+    bool ok = true;
+    Histogram histogram;
+    for (std::uint64_t value : {0ULL, 1ULL, 15ULL, 16ULL, 17ULL, 31ULL, 32ULL,
+                                1000ULL, 123456789ULL, ~0ULL}) {
+        const std::size_t index = Histogram::bucket_of(value);
+        ok = ok && index < Histogram::bucket_num;
+        if (value > 0) {
+            ok = ok && Histogram::bucket_of(value - 1) <= index;
+        }
+    }
+    for (std::uint64_t value = 1; value < (1ULL << 40); value = value * 3 + 1) {
+        const std::size_t index = Histogram::bucket_of(value);
+        histogram.counts[index] = 1;
+        histogram.count = 1;
+        histogram.max_ns = ~0ULL;
+        const std::uint64_t upper = histogram.percentile_ns(0.5);
+        histogram.counts[index] = 0;
+        ok = ok && upper >= value && (upper - value) * 16 <= value;
+    }
+    check(ok, "buckets", Mode::SHARED_QUEUE);
+}
+
+volatile double sink = 0;
+
+void work(int n) {
+    double x = 0;
+    for (int i = 1; i < n; ++i) { x += std::sqrt(static_cast<double>(i)); }
+    sink = x;
+}
+
+void print(const char *name, const Histogram &histogram) {
+    std::printf("  %-5s n=%-6llu avg %8.1f us  p50 %8.1f us  p99 %8.1f us  "
+                "max %8.1f us\n",
+                name, static_cast<unsigned long long>(histogram.count),
+                histogram.average_ns() / 1000,
+                static_cast<double>(histogram.percentile_ns(0.5)) / 1000,
+                static_cast<double>(histogram.percentile_ns(0.99)) / 1000,
+                static_cast<double>(histogram.max_ns) / 1000);
+}
+
+void run(Mode mode) {
+    constexpr int task_num = 4000;
+    SimpleThreadPool pool{2, mode};
+
+    // 外部线程和线程池内的线程都提交任务
+    std::vector<std::future<void>> results;
+    for (int i = 0; i < task_num / 2; ++i) {
+        results.push_back(pool.commit([&pool] {
+            work(2000);
+            pool.post([] { work(200); });
+        }));
+    }
+    for (auto &result : results) { result.get(); }
+    pool.drain();
+
+    const auto telemetry = pool.get_telemetry();
+    std::printf("%s: submitted %llu, completed %llu, high water %llu\n",
+                mode_name(mode),
+                static_cast<unsigned long long>(telemetry.submitted_num),
+                static_cast<unsigned long long>(telemetry.completed_num),
+                static_cast<unsigned long long>(telemetry.pending_high_water));
+    print("wait", telemetry.wait);
+    print("run", telemetry.run);
+
+    check(telemetry.submitted_num == task_num, "submitted", mode);
+    check(telemetry.completed_num == task_num, "completed", mode);
+    check(telemetry.queue_depth == 0, "queue depth", mode);
+    check(telemetry.wait.count == task_num && telemetry.run.count == task_num,
+          "histogram count", mode);
+    check(telemetry.pending_high_water > 1, "high water", mode);
+    check(telemetry.run.percentile_ns(0.5) <= telemetry.run.percentile_ns(0.99)
+              && telemetry.run.percentile_ns(0.99) <= telemetry.run.max_ns,
+          "percentiles", mode);
+}
+
+// 线程被阻塞时的排队深度，以及cancel()丢弃的任务
+void check_queue_depth(Mode mode) {
+    SimpleThreadPool pool{1, mode};
+    std::atomic_bool blocked{false};
+    std::atomic_bool released{false};
+    pool.post([&] {
+        blocked = true;
+        while (!released) { std::this_thread::yield(); }
+    });
+    while (!blocked) { std::this_thread::yield(); }
+
+    pool.reset_telemetry();
+    for (int i = 0; i < 100; ++i) { pool.post([] {}); }
+    auto telemetry = pool.get_telemetry();
+    check(telemetry.queue_depth == 100, "blocked depth", mode);
+    check(telemetry.pending_high_water == 101, "blocked high water", mode);
+
+    // 清零时已经在排队的任务仍然计入排队深度
+    pool.reset_telemetry();
+    telemetry = pool.get_telemetry();
+    check(telemetry.queue_depth == 100 && telemetry.submitted_num == 0,
+          "reset depth", mode);
+
+    // 阻塞的任务在清零之前开始，在清零之后结束
+    released = true;
+    pool.drain();
+    telemetry = pool.get_telemetry();
+    check(telemetry.queue_depth == 0 && telemetry.completed_num == 101,
+          "released depth", mode);
+}
+
+// 读取之前已经执行完的突发任务也计入最大值
+void check_burst_high_water(Mode mode) {
+    SimpleThreadPool pool{1, mode};
+    std::atomic_bool blocked{false};
+    std::atomic_bool released{false};
+    pool.post([&] {
+        blocked = true;
+        while (!released) { std::this_thread::yield(); }
+    });
+    while (!blocked) { std::this_thread::yield(); }
+
+    for (int i = 0; i < 50; ++i) { pool.post([] {}); }
+    released = true;
+    pool.drain();
+
+    const auto telemetry = pool.get_telemetry();
+    check(telemetry.submitted_num == 51 && telemetry.pending_high_water == 51,
+          "burst high water", mode);
+}
+
+// 多个外部线程同时提交，每个线程使用自己的计数器
+void check_external_threads(Mode mode) {
+    constexpr int thread_num = 4;
+    constexpr int task_num = 500;
+    SimpleThreadPool pool{2, mode};
+    std::atomic<int> done_num{0};
+
+    for (int round = 0; round < 2; ++round) {
+        // 第二轮的线程使用第一轮的线程退出时留下的计数器
+        std::vector<std::thread> threads;
+        for (int i = 0; i < thread_num; ++i) {
+            threads.emplace_back([&] {
+                for (int j = 0; j < task_num; ++j) {
+                    pool.post([&] { ++done_num; });
+                }
+            });
+        }
+        for (auto &thread : threads) { thread.join(); }
+    }
+    pool.drain();
+
+    const auto telemetry = pool.get_telemetry();
+    check(done_num == 2 * thread_num * task_num
+              && telemetry.submitted_num == 2 * thread_num * task_num
+              && telemetry.completed_num == 2 * thread_num * task_num,
+          "external threads", mode);
+}
+
+}  // namespace
+
+int main() {
+    check_buckets();
+    for (Mode mode : {Mode::SHARED_QUEUE, Mode::WORK_STEALING}) {
+        run(mode);
+        check_queue_depth(mode);
+        check_burst_high_water(mode);
+        check_external_threads(mode);
+    }
+
+    if (failed_num > 0) {
+        std::printf("%d checks failed\n", failed_num);
+        return 1;
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}
@@ -16,10 +16,18 @@
 
 #include "mlogfilemanager.hpp"
 
+#include "mlogsink.hpp"
+
 #include "mlogger.hpp"
 
+#include "mlogprofile.hpp"
+
+#include "mlogrecord.hpp"
+
 #include "mloggermanager.hpp"
 
+#include "mloghandle.hpp"
+
 /*
 这里有好几个单例，注意static变量最后的析构
 一个是单例的全局日志等级变量
@@ -28,10 +36,14 @@
 */
 
 // 提升常用的接口到MLog类
+// debug/info/warn/error返回一条临时记录，整条语句结束时作为一条记录整体写出，
+// 因此可以在多个线程中同时使用；out返回MLogger本身，直接写出，不保证线程安全
 class MLog {
 public:
     using Format = MLogTool::LogStartFormat;
     using Level = MLogTool::Level;
+    using Overflow = MLogTool::OverflowPolicy;
+    using Rotation = MLogFileManager::RotationPolicy;
 
     MLog() = delete;
     MLog(const MLog &) = delete;
@@ -50,10 +62,15 @@ public:
         return MLoggerManager::create_logger(logger_name);
     }
 
-    static MLogger &get_logger(const std::string &logger_name) {
+    static MLogger &get_logger(std::string_view logger_name) {
         return MLoggerManager::get_logger(logger_name);
     }
 
+    // 查找一次并返回句柄，之后通过句柄写日志不需要再查找
+    static MLogHandle get_handle(std::string_view logger_name) {
+        return MLogHandle{MLoggerManager::get_logger(logger_name)};
+    }
+
     static MLogger &get_logger_cout() {
         return MLoggerManager::get_logger_cout();
     }
@@ -66,45 +83,96 @@ public:
 
     static void show_detail() { MLoggerManager::show_detail(); }
 
+    // 定义了MLOG_PROFILE时，程序退出时向cerr输出各处日志语句的统计
+    static void set_profile_at_exit(bool flag) {
+        MLogProfiler::set_show_at_exit(flag);
+    }
+
     //----------------------------------------------------------------------------//
 
     static MLogger &out() { return MLoggerManager::get_logger_cout(); }
 
-    static MLogger &debug() {
+    static MLogRecord debug() {
         return MLoggerManager::get_logger_when(Level::debug);
     }
 
-    static MLogger &info() {
+    static MLogRecord info() {
         return MLoggerManager::get_logger_when(Level::info);
     }
 
-    static MLogger &warn() {
+    static MLogRecord warn() {
         return MLoggerManager::get_logger_when(Level::warn);
     }
 
-    static MLogger &error() {
+    static MLogRecord error() {
         return MLoggerManager::get_logger_when(Level::error);
     }
 
-    static MLogger &out(const std::string &logger_name) {
+    //----------------------------------------------------------------------------//
+    // 基于{}格式字符串的接口，向cout输出，末尾自动换行
+    // 例如 mlog::info_fmt("x = {}, y = {}", x, y);
+    // 指定logger时使用 mlog::get_logger("A").info_fmt(...)
+
+    template <typename... Args>
+    static void debug_fmt(MLogFormatString<Args...> fmt, const Args &...args) {
+        get_logger_cout().log_fmt<Args...>(Level::debug, fmt, args...);
+    }
+
+    template <typename... Args>
+    static void info_fmt(MLogFormatString<Args...> fmt, const Args &...args) {
+        get_logger_cout().log_fmt<Args...>(Level::info, fmt, args...);
+    }
+
+    template <typename... Args>
+    static void warn_fmt(MLogFormatString<Args...> fmt, const Args &...args) {
+        get_logger_cout().log_fmt<Args...>(Level::warn, fmt, args...);
+    }
+
+    template <typename... Args>
+    static void error_fmt(MLogFormatString<Args...> fmt, const Args &...args) {
+        get_logger_cout().log_fmt<Args...>(Level::error, fmt, args...);
+    }
+
+    //----------------------------------------------------------------------------//
+
+    static MLogger &out(std::string_view logger_name) {
         return MLoggerManager::get_logger(logger_name);
     }
 
-    static MLogger &debug(const std::string &logger_name) {
+    static MLogRecord debug(std::string_view logger_name) {
         return MLoggerManager::get_logger_when(Level::debug, logger_name);
     }
 
-    static MLogger &info(const std::string &logger_name) {
+    static MLogRecord info(std::string_view logger_name) {
         return MLoggerManager::get_logger_when(Level::info, logger_name);
     }
 
-    static MLogger &warn(const std::string &logger_name) {
+    static MLogRecord warn(std::string_view logger_name) {
         return MLoggerManager::get_logger_when(Level::warn, logger_name);
     }
 
-    static MLogger &error(const std::string &logger_name) {
+    static MLogRecord error(std::string_view logger_name) {
         return MLoggerManager::get_logger_when(Level::error, logger_name);
     }
+
+    //----------------------------------------------------------------------------//
+    // 通过缓存的句柄写日志，不需要按名称查找
+
+    static MLogRecord debug(const MLogHandle &handle) {
+        return handle.record(Level::debug);
+    }
+
+    static MLogRecord info(const MLogHandle &handle) {
+        return handle.record(Level::info);
+    }
+
+    static MLogRecord warn(const MLogHandle &handle) {
+        return handle.record(Level::warn);
+    }
+
+    static MLogRecord error(const MLogHandle &handle) {
+        return handle.record(Level::error);
+    }
 };
 
 // 加入一个别名，并且是小写的
@@ -18,32 +18,83 @@
 
 //----------------------------------------------------------------------------//
 
+// 源代码位置，只在真正输出时才会格式化
 #define MLOG_STAMP                                                             \
-    "[" + std::string(static_cast<const char *>(__FILE__)) + " "               \
-        + std::string(static_cast<const char *>(__FUNCTION__)) + " "           \
-        + std::to_string(__LINE__) + "]\n"
+    (MLogTool::SourceStamp{std::source_location::current(),                    \
+                           static_cast<const char *>(__FUNCTION__)})
 
-#define MLOG_DEBUG(...) (MLog::debug(__VA_ARGS__) << MLOG_STAMP)
-#define MLOG_INFO(...) (MLog::info(__VA_ARGS__) << MLOG_STAMP)
-#define MLOG_WARN(...) (MLog::warn(__VA_ARGS__) << MLOG_STAMP)
-#define MLOG_ERROR(...) (MLog::error(__VA_ARGS__) << MLOG_STAMP)
+// 日志等级不满足时整条语句(包括后面<<的参数)都不会被求值
+// 先判断全局等级，如果定义了MLOG_LEVEL，判断条件是编译期常量，
+// 不满足等级的语句会被直接删除；满足时才求值一次宏的参数，得到logger的记录，
+// logger自己的等级不满足(或者没有输出)时记录为空，后面<<的参数同样不会被求值
+// 写成只执行一次的for循环而不是if语句，避免与外层的if-else产生歧义
+#ifndef MLOG_PROFILE
 
+#define MLOG_LEVEL_DETAIL(level, func, ...)                                    \
+    for (MLogRecord mlog_tmp_record = MLogTool::is_level_enabled(level)        \
+                                          ? MLog::func(__VA_ARGS__)            \
+                                          : MLogRecord{};                      \
+         !mlog_tmp_record.is_empty(); mlog_tmp_record.finish())                \
+    mlog_tmp_record << MLOG_STAMP
+
+#else
+
+// 每一处宏通过一个立即调用的lambda持有自己的静态计数器
+#define MLOG_PROFILE_SITE                                                      \
+    [](const std::source_location &location) -> MLogProfileSite & {            \
+        static MLogProfileSite mlog_tmp_site{location};                        \
+        return mlog_tmp_site;                                                  \
+    }(std::source_location::current())
+
+// 计时对象在外层循环中，先于记录构造，在记录提交以后才析构
+#define MLOG_LEVEL_DETAIL(level, func, ...)                                    \
+    for (MLogProfileScope mlog_tmp_scope{MLOG_PROFILE_SITE};                   \
+         mlog_tmp_scope.start(MLogTool::is_level_enabled(level));)             \
+    for (MLogRecord mlog_tmp_record = MLog::func(__VA_ARGS__);                 \
+         !mlog_tmp_record.is_empty(); mlog_tmp_record.finish())                \
+    mlog_tmp_record << MLOG_STAMP
+
+#endif
+
+#define MLOG_DEBUG(...) MLOG_LEVEL_DETAIL(MLOG_LEVEL_DEBUG, debug, __VA_ARGS__)
+#define MLOG_INFO(...) MLOG_LEVEL_DETAIL(MLOG_LEVEL_INFO, info, __VA_ARGS__)
+#define MLOG_WARN(...) MLOG_LEVEL_DETAIL(MLOG_LEVEL_WARN, warn, __VA_ARGS__)
+#define MLOG_ERROR(...) MLOG_LEVEL_DETAIL(MLOG_LEVEL_ERROR, error, __VA_ARGS__)
+
+// 以下宏用于在循环中控制日志的输出频率，例如
+// MLOG_IF_EVERY_MS(100) { MLOG_INFO("A") << "i = " << i << '\n'; }
+// 每一处宏使用一个静态的原子计数器，可以在多个线程中同时使用，
+// 不满足条件时只需要一次原子读取(按时间控制的还需要读取一次时钟)
+
+// 只输出前x次
 #define MLOG_IF_FIRST_N(x)                                                     \
-    static auto mlog_tmp_first_##x = MLogTool::FirstN((x));                    \
-    if (mlog_tmp_first_##x.judge())
+    if (static MLogTool::FirstN mlog_tmp_limiter{(x)};                         \
+        mlog_tmp_limiter.judge())
 
+// 每x次输出一次
 #define MLOG_IF_EVERY_N(x)                                                     \
-    static auto mlog_tmp_every_##x = MLogTool::EveryN((x));                    \
-    if (mlog_tmp_every_##x.judge())
+    if (static MLogTool::EveryN mlog_tmp_limiter{(x)};                         \
+        mlog_tmp_limiter.judge())
 
+// 跳过前x次
 #define MLOG_IF_MORETHAN_N(x)                                                  \
-    static auto mlog_tmp_morethan_##x = MLogTool::MoreThanN((x));              \
-    if (mlog_tmp_morethan_##x.judge())
+    if (static MLogTool::MoreThanN mlog_tmp_limiter{(x)};                      \
+        mlog_tmp_limiter.judge())
+
+// 每隔ms毫秒最多输出一次
+#define MLOG_IF_EVERY_MS(ms)                                                   \
+    if (static MLogTool::EveryMs mlog_tmp_limiter{(ms)};                       \
+        mlog_tmp_limiter.judge())
+
+// 令牌桶限流，平均每秒最多输出per_sec次，允许突发per_sec次
+#define MLOG_RATE_LIMIT(per_sec)                                               \
+    if (static MLogTool::RateLimit mlog_tmp_limiter{(per_sec)};                \
+        mlog_tmp_limiter.judge())
 
 // 加一个临时性跳过某个函数的功能，但是会在控制台发出提示
 #define MLOG_SKIP(...)                                                         \
     do {                                                                       \
-        MLog::error() << MLOG_STAMP << "Skip the function!" << std::endl;      \
+        MLOG_ERROR() << "Skip the function!" << std::endl;                     \
         return __VA_ARGS__;                                                    \
     } while (false);
 
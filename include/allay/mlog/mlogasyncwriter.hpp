@@ -0,0 +1,365 @@
+#ifndef MLOGASYNCWRITER_H_
+#define MLOGASYNCWRITER_H_
+
+#include "mlogformat.hpp"
+#include "mlogtool.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// 有界无锁队列(多生产者多消费者)，参考Dmitry Vyukov的实现
+// 每个槽位带一个序号，入队和出队只需要一次CAS
+// 元素通过swap进出队列，或者直接在槽位中读写，
+// 使得字符串缓冲区可以在生产者和消费者之间循环复用
+template <typename T>
+class MLogBoundedQueue {
+public:
+    explicit MLogBoundedQueue(std::size_t capacity)
+        : m_capacity(round_up_pow2(capacity)), m_mask(m_capacity - 1),
+          m_cells(std::make_unique<Cell[]>(m_capacity)) {
+        for (std::size_t i = 0; i < m_capacity; ++i) {
+            m_cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MLogBoundedQueue(const MLogBoundedQueue &) = delete;
+    MLogBoundedQueue &operator=(const MLogBoundedQueue &) = delete;
+
+    // 队列已满时返回false，成功时value换回一个旧的元素
+    bool try_push(T &value) {
+        return try_push_with([&value](T &data) { std::swap(data, value); });
+    }
+
+    // 队列为空时返回false，成功时value换回队首元素
+    bool try_pop(T &value) {
+        return try_pop_with([&value](T &data) { std::swap(data, value); });
+    }
+
+    // 队列已满时返回false，否则占据一个槽位，由fill直接填写槽位中的元素
+    template <typename Func>
+    bool try_push_with(Func &&fill) {
+        std::size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        Cell *cell = nullptr;
+        while (true) {
+            cell = &m_cells[pos & m_mask];
+            const std::size_t seq = cell->seq.load(std::memory_order_acquire);
+            const auto dif =
+                static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+            if (dif == 0) {
+                if (m_enqueue_pos.compare_exchange_weak(
+                        pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (dif < 0) { return false; }
+            else { pos = m_enqueue_pos.load(std::memory_order_relaxed); }
+        }
+
+        fill(cell->data);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 队列为空时返回false，否则由take直接读取队首槽位中的元素
+    template <typename Func>
+    bool try_pop_with(Func &&take) {
+        std::size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+        Cell *cell = nullptr;
+        while (true) {
+            cell = &m_cells[pos & m_mask];
+            const std::size_t seq = cell->seq.load(std::memory_order_acquire);
+            const auto dif = static_cast<std::intptr_t>(seq)
+                             - static_cast<std::intptr_t>(pos + 1);
+            if (dif == 0) {
+                if (m_dequeue_pos.compare_exchange_weak(
+                        pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (dif < 0) { return false; }
+            else { pos = m_dequeue_pos.load(std::memory_order_relaxed); }
+        }
+
+        take(cell->data);
+        cell->seq.store(pos + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::size_t capacity() const { return m_capacity; }
+
+private:
+    struct Cell {
+        std::atomic<std::size_t> seq{0};
+        T data{};
+    };
+
+    static std::size_t round_up_pow2(std::size_t n) {
+        std::size_t result = 2;
+        while (result < n) { result <<= 1; }
+        return result;
+    }
+
+    const std::size_t m_capacity;
+    const std::size_t m_mask;
+    std::unique_ptr<Cell[]> m_cells;
+
+    // 生产者和消费者的位置分开放在不同的缓存行，避免伪共享
+    alignas(64) std::atomic<std::size_t> m_enqueue_pos{0};
+    alignas(64) std::atomic<std::size_t> m_dequeue_pos{0};
+};
+
+// 后台写线程
+// 调用方只负责把一行记录格式化到暂存区，遇到换行时提交到队列，
+// 或者通过push直接提交一条在别处格式化好的完整记录
+// 记录中可以带有延迟格式化的参数，由后台线程在写出时再格式化
+// 后台线程把队列中的多条记录拼接成一个大块，一次性交给handler写出
+// 后台线程没有记录时在条件变量上休眠，调用方只在它休眠时才唤醒，
+// 后台线程忙碌时调用方的常规路径上只有一次原子读，没有系统调用
+// BLOCK策略下如果sink或者handler在后台线程中向同一个logger写记录，
+// 队列已满时不能等待自己腾出空间，这条记录会被丢弃并计入dropped
+class MLogAsyncWriter {
+public:
+    using Level = MLogTool::Level;
+    using Overflow = MLogTool::OverflowPolicy;
+
+    // 队列中的一条记录
+    struct Entry {
+        std::string text;       // 已经格式化的部分
+        MLogDeferred deferred;  // format非空时，写出时在text之后追加
+        Level level{Level::off};
+        bool is_record{false};  // 通过push提交的完整记录，而不是暂存区中的一行
+    };
+
+    // 一批中每条完整记录的位置和等级，用于分发到logger的sink
+    struct RecordSpan {
+        std::size_t begin;
+        std::size_t size;
+        Level level;
+    };
+
+    using Handler = std::function<void(std::string_view,
+                                       const std::vector<RecordSpan> &)>;
+    // 写出之前检查是否还有输出目标接受这个等级，不接受的记录不再格式化
+    using Accept = std::function<bool(Level)>;
+
+    struct Stats {
+        std::uint64_t enqueued{0};  // 成功进入队列的记录数
+        std::uint64_t written{0};   // 已经写出的记录数，不含没有输出目标的记录
+        std::uint64_t dropped{0};   // 因为队列已满而丢弃的记录数
+    };
+
+    MLogAsyncWriter(std::size_t capacity, Overflow overflow, Handler handler,
+                    Accept accept = {})
+        : m_queue(capacity), m_overflow(overflow),
+          m_handler(std::move(handler)), m_accept(std::move(accept)) {
+        m_thread = std::thread([this] { run(); });
+    }
+
+    MLogAsyncWriter(const MLogAsyncWriter &) = delete;
+    MLogAsyncWriter &operator=(const MLogAsyncWriter &) = delete;
+
+    // 析构时先写出所有剩余记录，再结束后台线程
+    ~MLogAsyncWriter() {
+        commit();
+        m_running.store(false);
+        wake_up();
+        if (m_thread.joinable()) { m_thread.join(); }
+    }
+
+    // 追加到当前行，遇到换行时提交
+    template <typename MessageType>
+    void append(const MessageType &msg) {
+        m_line_stream << msg;
+        if (!m_line.empty() && m_line.back() == '\n') { commit(); }
+    }
+
+    // 把暂存区中的内容作为一行提交到队列
+    void commit() { push_detail(m_line, nullptr, Level::off, false); }
+
+    // 把一条完整的记录提交到队列，可以被多个线程同时调用
+    // deferred非空时，其中的参数由后台线程格式化后追加在record之后
+    // 返回后record被清空，但是保留换回来的旧缓冲区的容量
+    void push(std::string &record, Level level,
+              const MLogDeferred *deferred = nullptr) {
+        push_detail(record, deferred, level, true);
+    }
+
+    // 等待在此之前进入队列的所有记录被写出，可以被任意线程调用
+    // 不会提交暂存区，没有换行的一行仍然留在暂存区中，由所属的调用线程提交
+    // 其它线程在flush期间提交的记录不保证被等待
+    void flush() {
+        const std::uint64_t target = m_enqueued.load(std::memory_order_acquire);
+        std::uint64_t retired = m_retired.load(std::memory_order_acquire);
+        if (retired < target) { wake_up(); }
+        while (retired < target) {
+            m_retired.wait(retired, std::memory_order_acquire);
+            retired = m_retired.load(std::memory_order_acquire);
+        }
+    }
+
+    Stats get_stats() const {
+        return Stats{m_enqueued.load(std::memory_order_acquire),
+                     m_written.load(std::memory_order_acquire),
+                     m_dropped.load(std::memory_order_acquire)};
+    }
+
+private:
+    // 每次批量写出的字节数上限
+    constexpr static std::size_t batch_bytes = 64 * 1024;
+
+    void run() {
+        std::string batch;
+        batch.reserve(batch_bytes);
+        std::vector<RecordSpan> spans;
+
+        std::uint64_t skipped = 0;
+
+        auto take = [this, &batch, &spans, &skipped](Entry &entry) {
+            if (entry.is_record && m_accept && !m_accept(entry.level)) {
+                ++skipped;
+                return;
+            }
+            const std::size_t begin = batch.size();
+            batch += entry.text;
+            if (entry.deferred.format != nullptr) {
+                entry.deferred.expand(batch);
+            }
+            if (entry.is_record) {
+                spans.push_back({begin, batch.size() - begin, entry.level});
+            }
+        };
+
+        while (true) {
+            std::uint64_t count = 0;
+            while (batch.size() < batch_bytes && m_queue.try_pop_with(take)) {
+                ++count;
+            }
+
+            if (count > 0) {
+                if (count > skipped) { m_handler(batch, spans); }
+                batch.clear();
+                spans.clear();
+                m_written.fetch_add(count - skipped, std::memory_order_release);
+                skipped = 0;
+                m_retired.fetch_add(count, std::memory_order_release);
+                m_retired.notify_all();
+                continue;
+            }
+
+            if (!m_running.load(std::memory_order_acquire)) { break; }
+
+            // 先声明将要休眠，再检查是否有新的记录，
+            // 与调用方的入队计数和休眠标志的检查构成对称的顺序，不会丢失唤醒
+            std::unique_lock<std::mutex> lock(m_wait_mtx);
+            m_sleeping.store(true);
+            m_wait_cv.wait(lock, [this] {
+                return m_enqueued.load() != m_retired.load()
+                       || !m_running.load();
+            });
+            m_sleeping.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    // 只有后台线程正在休眠时才加锁通知
+    void wake_up() {
+        if (m_sleeping.load()) {
+            std::lock_guard<std::mutex> lock(m_wait_mtx);
+            m_wait_cv.notify_one();
+        }
+    }
+
+    void push_detail(std::string &record, const MLogDeferred *deferred,
+                     Level level, bool is_record) {
+        if (record.empty() && deferred == nullptr) { return; }
+
+        auto fill = [&record, deferred, level, is_record](Entry &entry) {
+            std::swap(entry.text, record);
+            if (deferred != nullptr) { entry.deferred = *deferred; }
+            else { entry.deferred.format = nullptr; }
+            entry.level = level;
+            entry.is_record = is_record;
+        };
+
+        if (!m_queue.try_push_with(fill)) {
+            switch (m_overflow) {
+            case Overflow::DROP_NEWEST:
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                record.clear();
+                return;
+            case Overflow::DROP_OLDEST: push_drop_oldest(fill); break;
+            case Overflow::BLOCK:
+            default:
+                if (push_block(fill)) { break; }
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                record.clear();
+                return;
+            }
+        }
+
+        record.clear();
+        m_enqueued.fetch_add(1);
+        wake_up();
+    }
+
+
+    // 等待后台线程腾出空间
+    // 在后台线程中(sink或者handler写同一个logger)等待会死锁，此时丢弃这条记录
+    // 返回false表示记录被丢弃
+    template <typename Func>
+    bool push_block(Func &fill) {
+        if (std::this_thread::get_id() == m_thread.get_id()) { return false; }
+        while (true) {
+            const std::uint64_t retired =
+                m_retired.load(std::memory_order_acquire);
+            if (m_queue.try_push_with(fill)) { return true; }
+            wake_up();
+            m_retired.wait(retired, std::memory_order_acquire);
+        }
+    }
+
+    // 从队首弹出并丢弃最早的记录，直到成功入队
+    template <typename Func>
+    void push_drop_oldest(Func &fill) {
+        while (!m_queue.try_push_with(fill)) {
+            if (m_queue.try_pop_with([](Entry & /*oldest*/) {})) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                m_retired.fetch_add(1, std::memory_order_release);
+                m_retired.notify_all();
+            }
+        }
+    }
+
+    MLogBoundedQueue<Entry> m_queue;
+    const Overflow m_overflow;
+    Handler m_handler;
+    Accept m_accept;
+
+    // 调用方的暂存区，只被所属logger的调用线程访问
+    std::string m_line;
+    MLogTool::StringBuf m_line_buf{m_line};
+    std::ostream m_line_stream{&m_line_buf};
+
+    std::atomic_bool m_running{true};
+    std::atomic_bool m_sleeping{false};  // 后台线程正在或者将要在m_wait_cv上休眠
+    std::mutex m_wait_mtx;
+    std::condition_variable m_wait_cv;
+    std::atomic<std::uint64_t> m_enqueued{0};
+    std::atomic<std::uint64_t> m_retired{0};  // 已写出或已丢弃的入队记录数
+    std::atomic<std::uint64_t> m_written{0};
+    std::atomic<std::uint64_t> m_dropped{0};
+
+    std::thread m_thread;
+};
+
+#endif  // MLOGASYNCWRITER_H_
@@ -0,0 +1,404 @@
+#ifndef MLOGBINARY_H_
+#define MLOGBINARY_H_
+
+#include "mlogformat.hpp"
+#include "mlogtool.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+// 二进制日志文件的格式(按照本机字节序，只保证在同一平台上解码)
+//
+// 文件头:
+//   char[8]  magic "MLOGBIN"
+//   u32      版本号
+//   u32      签名长度，随后是签名，例如{A}
+//   i64      打开文件时system_clock的纳秒数
+//   i64      打开文件时steady_clock的计数
+//   i64 i64  steady_clock计数单位的分子和分母(秒)
+//
+// 之后是一系列记录，第一个字节是记录类型:
+//   1 格式定义: u32 id, u32 参数个数, 参数类型码, u32 长度, 格式字符串
+//   2 格式记录: u32 id, u8 等级, u8 开头格式, i64 steady_clock计数, 参数
+//              数值参数直接保存原始字节，字符串参数保存为u32长度和内容
+//   3 文本记录: u32 长度, 已经格式化好的文本
+class MLogBinary {
+public:
+    constexpr static char magic[8] = {'M', 'L', 'O', 'G', 'B', 'I', 'N', '\0'};
+    constexpr static std::uint32_t version = 1;
+
+    enum class RecordType : std::uint8_t {
+        DEFINE = 1,
+        FORMAT = 2,
+        TEXT = 3,
+    };
+
+    // 参数的类型码，整数按照大小和符号归一化
+    template <typename T>
+    constexpr static char type_code() {
+        using Type = std::decay_t<T>;
+
+        if constexpr (std::is_same_v<Type, bool>) { return 'b'; }
+        else if constexpr (std::is_same_v<Type, char>) { return 'c'; }
+        else if constexpr (std::is_enum_v<Type>) {
+            return type_code<std::underlying_type_t<Type>>();
+        }
+        else if constexpr (std::is_integral_v<Type>) {
+            constexpr bool is_signed = std::is_signed_v<Type>;
+            if constexpr (sizeof(Type) == 1) { return is_signed ? 'a' : 'h'; }
+            else if constexpr (sizeof(Type) == 2) {
+                return is_signed ? 's' : 't';
+            }
+            else if constexpr (sizeof(Type) == 4) {
+                return is_signed ? 'i' : 'j';
+            }
+            else { return is_signed ? 'l' : 'm'; }
+        }
+        else if constexpr (std::is_same_v<Type, float>) { return 'f'; }
+        else if constexpr (std::is_floating_point_v<Type>) { return 'd'; }
+        else { return 'S'; }
+    }
+
+    template <typename T>
+    constexpr static bool can_encode_one =
+        std::is_arithmetic_v<std::decay_t<T>> || std::is_enum_v<std::decay_t<T>>
+        || std::is_convertible_v<const T &, std::string_view>;
+
+    template <typename... Args>
+    constexpr static bool can_encode = (can_encode_one<Args> && ...);
+
+    // 每一种参数类型组合对应一个唯一的类型码字符串，可以用地址区分
+    template <typename... Args>
+    constexpr static char signature[] = {type_code<Args>()..., '\0'};
+};
+
+// 二进制日志的写入端，调用方负责加锁
+// 热路径只是把参数的原始字节复制到缓冲区，缓冲区满了以后再写入文件
+class MLogBinaryWriter {
+public:
+    using Level = MLogTool::Level;
+    using Format = MLogTool::LogStartFormat;
+
+    MLogBinaryWriter(std::shared_ptr<std::ofstream> ofs,
+                     std::string_view signature)
+        : m_ofs(std::move(ofs)) {
+        m_buffer.reserve(buffer_bytes * 2);
+
+        const auto system_now = std::chrono::system_clock::now();
+        const auto steady_now = std::chrono::steady_clock::now();
+
+        m_buffer.append(static_cast<const char *>(MLogBinary::magic),
+                        sizeof(MLogBinary::magic));
+        put(MLogBinary::version);
+        put_string(signature);
+        put(static_cast<std::int64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                system_now.time_since_epoch())
+                .count()));
+        put(static_cast<std::int64_t>(steady_now.time_since_epoch().count()));
+        put(static_cast<std::int64_t>(std::chrono::steady_clock::period::num));
+        put(static_cast<std::int64_t>(std::chrono::steady_clock::period::den));
+    }
+
+    MLogBinaryWriter(const MLogBinaryWriter &) = delete;
+    MLogBinaryWriter &operator=(const MLogBinaryWriter &) = delete;
+
+    ~MLogBinaryWriter() {
+        commit();
+        flush();
+    }
+
+    // 写入一条格式记录，第一次遇到的格式字符串会先写入它的定义
+    // 返回写入的字节数
+    template <typename... Args>
+    std::size_t write_format(Level level, Format log_start_format,
+                             std::string_view fmt, const Args &...args) {
+        const std::size_t old_size = m_buffer.size();
+        const std::uint32_t id = get_format_id(
+            fmt, static_cast<const char *>(MLogBinary::signature<Args...>));
+
+        put(MLogBinary::RecordType::FORMAT);
+        put(id);
+        put(static_cast<std::uint8_t>(level));
+        put(static_cast<std::uint8_t>(log_start_format));
+        put(static_cast<std::int64_t>(
+            std::chrono::steady_clock::now().time_since_epoch().count()));
+        (put_arg(args), ...);
+
+        const std::size_t bytes = m_buffer.size() - old_size;
+        if (m_buffer.size() >= buffer_bytes) { flush(); }
+        return bytes;
+    }
+
+    // 写入一条已经格式化好的文本记录
+    void write_text(std::string_view text) {
+        if (text.empty()) { return; }
+
+        put(MLogBinary::RecordType::TEXT);
+        put_string(text);
+
+        if (m_buffer.size() >= buffer_bytes) { flush(); }
+    }
+
+    // 直接对logger使用<<时，先暂存到当前行，遇到换行时作为一条文本记录写入
+    template <typename MessageType>
+    void append(const MessageType &msg) {
+        m_line_stream << msg;
+        if (!m_line.empty() && m_line.back() == '\n') { commit(); }
+    }
+
+    void commit() {
+        write_text(m_line);
+        m_line.clear();
+    }
+
+    // 把缓冲区写入文件流
+    void flush() {
+        if (m_buffer.empty()) { return; }
+
+        m_ofs->write(m_buffer.data(),
+                     static_cast<std::streamsize>(m_buffer.size()));
+        m_buffer.clear();
+    }
+
+private:
+    // 缓冲区超过这个大小时写入文件流
+    constexpr static std::size_t buffer_bytes = 64 * 1024;
+
+    template <typename T>
+    void put(const T &value) {
+        m_buffer.append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    void put_string(std::string_view str) {
+        put(static_cast<std::uint32_t>(str.size()));
+        m_buffer += str;
+    }
+
+    template <typename T>
+    void put_arg(const T &value) {
+        using Type = std::decay_t<T>;
+
+        if constexpr (std::is_enum_v<Type>) {
+            put(static_cast<std::underlying_type_t<Type>>(value));
+        }
+        else if constexpr (std::is_floating_point_v<Type>
+                           && !std::is_same_v<Type, float>) {
+            put(static_cast<double>(value));
+        }
+        else if constexpr (std::is_arithmetic_v<Type>) { put(value); }
+        else { put_string(std::string_view{value}); }
+    }
+
+    std::uint32_t get_format_id(std::string_view fmt, const char *types) {
+        const auto key = std::make_tuple(fmt.data(), fmt.size(), types);
+        if (auto iter = m_format_ids.find(key); iter != m_format_ids.end()) {
+            return iter->second;
+        }
+
+        const auto id = static_cast<std::uint32_t>(m_format_ids.size());
+        m_format_ids.emplace(key, id);
+
+        const std::string_view type_codes{types};
+        put(MLogBinary::RecordType::DEFINE);
+        put(id);
+        put_string(type_codes);
+        put_string(fmt);
+        return id;
+    }
+
+    std::shared_ptr<std::ofstream> m_ofs;
+    std::string m_buffer;
+    std::map<std::tuple<const char *, std::size_t, const char *>,
+             std::uint32_t>
+        m_format_ids;
+
+    std::string m_line;
+    MLogTool::StringBuf m_line_buf{m_line};
+    std::ostream m_line_stream{&m_line_buf};
+};
+
+// 二进制日志的解码端，输出与文本日志相同的格式
+class MLogBinaryReader {
+public:
+    using Level = MLogTool::Level;
+    using Format = MLogTool::LogStartFormat;
+
+    // 解码整个二进制日志，格式错误时返回false
+    static bool decode(std::istream &in, std::ostream &out) {
+        MLogBinaryReader reader(in);
+        if (!reader.read_header()) { return false; }
+
+        std::string text;
+        while (true) {
+            text.clear();
+            const int status = reader.read_record(text);
+            if (status < 0) { return false; }
+            if (status == 0) { return true; }
+            out << text;
+        }
+    }
+
+private:
+    struct Definition {
+        std::string types;
+        std::string fmt;
+    };
+
+    explicit MLogBinaryReader(std::istream &in) : m_in(in) {}
+
+    template <typename T>
+    bool get(T &value) {
+        m_in.read(reinterpret_cast<char *>(&value), sizeof(T));
+        return static_cast<bool>(m_in);
+    }
+
+    bool get_string(std::string &str) {
+        std::uint32_t size = 0;
+        if (!get(size)) { return false; }
+        str.resize(size);
+        m_in.read(str.data(), static_cast<std::streamsize>(size));
+        return static_cast<bool>(m_in);
+    }
+
+    bool read_header() {
+        char magic[sizeof(MLogBinary::magic)]{};
+        m_in.read(static_cast<char *>(magic), sizeof(magic));
+        if (!m_in
+            || std::memcmp(static_cast<char *>(magic),
+                           static_cast<const char *>(MLogBinary::magic),
+                           sizeof(magic))
+                   != 0) {
+            return false;
+        }
+
+        std::uint32_t file_version = 0;
+        if (!get(file_version) || file_version != MLogBinary::version) {
+            return false;
+        }
+
+        return get_string(m_signature) && get(m_system_ns) && get(m_steady_ticks)
+               && get(m_period_num) && get(m_period_den) && m_period_den != 0;
+    }
+
+    // 读取一条记录并追加文本，返回1表示成功，0表示文件结束，-1表示格式错误
+    int read_record(std::string &text) {
+        MLogBinary::RecordType type{};
+        m_in.read(reinterpret_cast<char *>(&type), sizeof(type));
+        if (m_in.eof() && m_in.gcount() == 0) { return 0; }
+        if (!m_in) { return -1; }
+
+        // 追加写入的文件中可能出现新的文件头，此后的格式编号重新开始
+        if (static_cast<char>(type) == MLogBinary::magic[0]) {
+            m_in.unget();
+            m_definitions.clear();
+            return read_header() ? 1 : -1;
+        }
+
+        switch (type) {
+        case MLogBinary::RecordType::DEFINE: {
+            std::uint32_t id = 0;
+            Definition def;
+            if (!get(id) || !get_string(def.types) || !get_string(def.fmt)) {
+                return -1;
+            }
+            if (id != m_definitions.size()) { return -1; }
+            m_definitions.push_back(std::move(def));
+            return 1;
+        }
+        case MLogBinary::RecordType::FORMAT: return read_format(text) ? 1 : -1;
+        case MLogBinary::RecordType::TEXT: return get_string(text) ? 1 : -1;
+        default: return -1;
+        }
+    }
+
+    bool read_format(std::string &text) {
+        std::uint32_t id = 0;
+        std::uint8_t level = 0;
+        std::uint8_t log_start_format = 0;
+        std::int64_t ticks = 0;
+        if (!get(id) || !get(level) || !get(log_start_format) || !get(ticks)
+            || id >= m_definitions.size()) {
+            return false;
+        }
+
+        // 由steady_clock计数换算回system_clock时刻
+        const auto elapsed_ns = static_cast<std::int64_t>(
+            static_cast<long double>(ticks - m_steady_ticks) * m_period_num
+            * 1000000000 / m_period_den);
+        const std::chrono::system_clock::time_point time{
+            std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                std::chrono::nanoseconds{m_system_ns + elapsed_ns})};
+
+        MLogTool::append_log_start(
+            text, static_cast<Level>(level),
+            static_cast<Format>(log_start_format), m_signature,
+            [time] { return time; }, false);
+
+        const Definition &def = m_definitions[id];
+        text += ' ';
+        std::string_view fmt{def.fmt};
+        for (const char code : def.types) {
+            const std::size_t next = MLogFormatter::append_literal(text, fmt);
+            if (!read_arg(code, text)) { return false; }
+            fmt = fmt.substr(next);
+        }
+        MLogFormatter::format_to(text, fmt);
+        text += '\n';
+        return true;
+    }
+
+    template <typename T>
+    bool read_value(std::string &text) {
+        T value{};
+        if (!get(value)) { return false; }
+        MLogFormatter::append_value(text, value);
+        return true;
+    }
+
+    bool read_arg(char code, std::string &text) {
+        switch (code) {
+        case 'b': return read_value<bool>(text);
+        case 'c': return read_value<char>(text);
+        case 'a': return read_value<std::int8_t>(text);
+        case 'h': return read_value<std::uint8_t>(text);
+        case 's': return read_value<std::int16_t>(text);
+        case 't': return read_value<std::uint16_t>(text);
+        case 'i': return read_value<std::int32_t>(text);
+        case 'j': return read_value<std::uint32_t>(text);
+        case 'l': return read_value<std::int64_t>(text);
+        case 'm': return read_value<std::uint64_t>(text);
+        case 'f': return read_value<float>(text);
+        case 'd': return read_value<double>(text);
+        case 'S': {
+            std::string str;
+            if (!get_string(str)) { return false; }
+            text += str;
+            return true;
+        }
+        default: return false;
+        }
+    }
+
+    std::istream &m_in;
+    std::string m_signature;
+    std::int64_t m_system_ns{0};
+    std::int64_t m_steady_ticks{0};
+    std::int64_t m_period_num{1};
+    std::int64_t m_period_den{1};
+    std::vector<Definition> m_definitions;
+};
+
+#endif  // MLOGBINARY_H_
@@ -4,15 +4,35 @@
 #include "mlogtool.hpp"
 
 #include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
 #include <map>
 #include <memory>
 #include <string>
+#include <system_error>
 
 // 最底层的文件层，一个文件名提供一个ofstream
-// 必须被一个logger独占，通过map来管理，但是不负责文件打开关闭的细节
+// 必须被一个logger或者文件sink独占，通过map来管理，但是不负责文件打开关闭的细节
+// 另外负责日志文件轮转时历史文件的改名和清理
 class MLogFileManager {
 public:
-    friend class MLogger;  // 所有的接口只可以被logger调用
+    friend class MLogger;  // 所有的接口只可以被logger和文件sink调用
+    friend class MLogFileSink;
+
+    // 日志文件的轮转策略，各项为0时表示不限制
+    // 超过大小或者时长以后，当前文件改名为xxx.log.1，原有的历史文件依次后移，
+    // 然后重新打开xxx.log继续写入
+    struct RotationPolicy {
+        std::uintmax_t max_bytes{0};    // 单个文件的最大字节数
+        std::chrono::seconds max_age{0};  // 单个文件的最长写入时间
+        std::size_t max_files{0};       // 最多保留的历史文件数
+
+        bool enabled() const {
+            return (max_bytes > 0) || (max_age.count() > 0);
+        }
+    };
 
     MLogFileManager &operator=(const MLogFileManager &) = delete;
     MLogFileManager(const MLogFileManager &) = delete;
@@ -37,22 +57,19 @@ private:
     // 注意内部map会把这个文件名改成小写来存储和查询，但是不影响真实文件名
     static std::shared_ptr<std::ofstream>
     get_unique_ofstream(const std::string &raw_file_name) {
-        // 存储的map使用的是全小写
-        std::string file_name = to_low(raw_file_name);
-
-        // 如果已经存在，不会给新的用户
-        if (get_instance().m_ofstream_map.find(file_name)
-            != get_instance().m_ofstream_map.end())
+        // 名称不合法不分配
+        if (raw_file_name.empty()
+            || !MLogTool::check_filename_valid(raw_file_name))
             return nullptr;
 
-        // 名称不合法也不分配
-        if (file_name.empty() || !MLogTool::check_filename_valid(file_name))
-            return nullptr;
+        // 存储的map使用的是全小写
+        // 如果已经存在，不会给新的用户，否则分配并存储新的日志文件流
+        auto [iter, inserted] =
+            get_instance().m_ofstream_map.try_emplace(to_low(raw_file_name));
+        if (!inserted) return nullptr;
 
-        // 分配并存储新的日志文件流
-        get_instance().m_ofstream_map[file_name] =
-            std::make_shared<std::ofstream>();
-        return get_instance().m_ofstream_map[file_name];
+        iter->second = std::make_shared<std::ofstream>();
+        return iter->second;
     }
 
     // 负责erase，但是不负责文件关闭
@@ -65,6 +82,48 @@ private:
             get_instance().m_ofstream_map.erase(iter);
     }
 
+    // 第index个历史文件的完整路径，index从1开始，越小越新
+    static std::string rotated_file_name(const std::string &full_file_name,
+                                         std::size_t index) {
+        return full_file_name + "." + std::to_string(index);
+    }
+
+    // 把当前文件改名为第1个历史文件，原有的历史文件依次后移
+    // 超出max_files的最旧的文件被删除，max_files为0时保留全部
+    // 调用前文件需要已经关闭，失败时返回false
+    static bool rotate_files(const std::string &full_file_name,
+                             std::size_t max_files) {
+        namespace fs = std::filesystem;
+        std::error_code ec;
+
+        // 找到第一个空位，之后的历史文件不受影响
+        std::size_t last = 1;
+        while (fs::exists(rotated_file_name(full_file_name, last), ec)
+               && (max_files == 0 || last < max_files)) {
+            ++last;
+        }
+        if (max_files > 0 && last >= max_files) {
+            fs::remove(rotated_file_name(full_file_name, max_files), ec);
+            last = max_files;
+        }
+
+        for (std::size_t i = last; i > 1; --i) {
+            fs::rename(rotated_file_name(full_file_name, i - 1),
+                       rotated_file_name(full_file_name, i), ec);
+            if (ec) { return false; }
+        }
+
+        fs::rename(full_file_name, rotated_file_name(full_file_name, 1), ec);
+        return !ec;
+    }
+
+    // 以追加方式打开时，已有的内容也计入文件大小
+    static std::uintmax_t file_size(const std::string &full_file_name) {
+        std::error_code ec;
+        const auto size = std::filesystem::file_size(full_file_name, ec);
+        return ec ? 0 : size;
+    }
+
     static MLogFileManager &get_instance() {
         static MLogFileManager the_logfile_manager;
         return the_logfile_manager;
@@ -0,0 +1,212 @@
+#ifndef MLOGFORMAT_H_
+#define MLOGFORMAT_H_
+
+#include "mlogtool.hpp"
+
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+// 轻量的{}格式化，语法是std::format的一个子集
+// 只支持{}占位符以及{{和}}转义，不支持格式说明
+// 数值直接通过to_chars写入缓冲区，不经过ostream
+class MLogFormatter {
+public:
+    // 检查格式字符串，返回{}的个数，格式错误时返回-1
+    constexpr static int count_placeholders(std::string_view fmt) {
+        int count = 0;
+        for (std::size_t i = 0; i < fmt.size(); ++i) {
+            if (fmt[i] == '{') {
+                if (i + 1 < fmt.size() && fmt[i + 1] == '{') { ++i; }
+                else if (i + 1 < fmt.size() && fmt[i + 1] == '}') {
+                    ++i;
+                    ++count;
+                }
+                else { return -1; }
+            }
+            else if (fmt[i] == '}') {
+                if (i + 1 < fmt.size() && fmt[i + 1] == '}') { ++i; }
+                else { return -1; }
+            }
+        }
+        return count;
+    }
+
+    // 按照格式字符串把参数追加到out中，格式字符串需要事先检查
+    static void format_to(std::string &out, std::string_view fmt) {
+        append_literal(out, fmt);
+    }
+
+    template <typename T, typename... Rest>
+    static void format_to(std::string &out, std::string_view fmt,
+                          const T &value, const Rest &...rest) {
+        const std::size_t next = append_literal(out, fmt);
+        append_value(out, value);
+        format_to(out, fmt.substr(next), rest...);
+    }
+
+    // 把单个值追加到out中
+    template <typename T>
+    static void append_value(std::string &out, const T &value) {
+        using Type = std::decay_t<T>;
+
+        if constexpr (std::is_same_v<Type, bool>) {
+            out += value ? "true" : "false";
+        }
+        else if constexpr (std::is_same_v<Type, char>) { out += value; }
+        else if constexpr (std::is_arithmetic_v<Type>) {
+            char buffer[64]{};
+            auto result = std::to_chars(static_cast<char *>(buffer),
+                                        static_cast<char *>(buffer)
+                                            + sizeof(buffer),
+                                        value);
+            out.append(static_cast<char *>(buffer), result.ptr);
+        }
+        else if constexpr (std::is_enum_v<Type>) {
+            append_value(out, static_cast<std::underlying_type_t<Type>>(value));
+        }
+        else if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+            out += std::string_view{value};
+        }
+        else if constexpr (std::is_pointer_v<Type>) {
+            char buffer[32]{};
+            auto result = std::to_chars(
+                static_cast<char *>(buffer),
+                static_cast<char *>(buffer) + sizeof(buffer),
+                reinterpret_cast<std::uintptr_t>(value), 16);
+            out += "0x";
+            out.append(static_cast<char *>(buffer), result.ptr);
+        }
+        else {
+            // 其它类型使用它自己的operator<<
+            MLogTool::StringBuf buf(out);
+            std::ostream os(&buf);
+            os << value;
+        }
+    }
+
+    // 追加第一个{}之前的内容，返回{}之后的位置
+    static std::size_t append_literal(std::string &out, std::string_view fmt) {
+        std::size_t i = 0;
+        while (i < fmt.size()) {
+            const std::size_t pos = fmt.find_first_of("{}", i);
+            if (pos == std::string_view::npos) {
+                out += fmt.substr(i);
+                return fmt.size();
+            }
+
+            out += fmt.substr(i, pos - i);
+            if (fmt[pos] == '{' && pos + 1 < fmt.size() && fmt[pos + 1] == '}') {
+                return pos + 2;
+            }
+            out += fmt[pos];  // {{或者}}，只保留一个
+            i = pos + 2;
+        }
+        return fmt.size();
+    }
+};
+
+// 编译期检查的格式字符串，参考std::basic_format_string
+// 占位符个数与参数个数不一致时无法通过编译
+template <typename... Args>
+class MLogBasicFormatString {
+public:
+    template <typename S>
+        requires std::convertible_to<const S &, std::string_view>
+    consteval MLogBasicFormatString(const S &str)  // NOLINT
+        : m_str(str) {
+        if (MLogFormatter::count_placeholders(m_str)
+            != static_cast<int>(sizeof...(Args))) {
+            format_string_does_not_match_arguments();
+        }
+    }
+
+    constexpr std::string_view get() const { return m_str; }
+
+private:
+    // 不是constexpr函数，在编译期被调用时产生编译错误
+    static void format_string_does_not_match_arguments() {}
+
+    std::string_view m_str;
+};
+
+template <typename... Args>
+using MLogFormatString =
+    MLogBasicFormatString<std::type_identity_t<Args>...>;
+
+// 延迟格式化的参数
+// 只有全部参数都是数值、字符或者枚举时才可以延迟，参数按值紧密排列保存，
+// 由后台线程在写出时再格式化；格式字符串必须具有静态生存期(编译期检查保证)
+struct MLogDeferred {
+    using FormatFn = void (*)(std::string &, std::string_view,
+                              const unsigned char *);
+
+    constexpr static std::size_t capacity = 64;
+
+    template <typename... Args>
+    constexpr static bool can_defer =
+        (sizeof...(Args) > 0)
+        && ((std::is_arithmetic_v<std::decay_t<Args>>
+          || std::is_enum_v<std::decay_t<Args>>)
+         && ...)
+        && ((sizeof(std::decay_t<Args>) + ... + 0) <= capacity);
+
+    FormatFn format{nullptr};
+    std::string_view fmt;
+    unsigned char args[capacity];  // NOLINT
+
+    template <typename... Args>
+    void capture(std::string_view fmt_str, const Args &...values) {
+        static_assert(can_defer<Args...>);
+
+        format = &format_detail<std::decay_t<Args>...>;
+        fmt = fmt_str;
+        std::size_t offset = 0;
+        ((store(offset, static_cast<std::decay_t<Args>>(values))), ...);
+    }
+
+    // 追加格式化的结果，与直接格式化时的输出一致
+    void expand(std::string &out) const {
+        out += ' ';
+        format(out, fmt, static_cast<const unsigned char *>(args));
+        out += '\n';
+    }
+
+private:
+    template <typename T>
+    void store(std::size_t &offset, const T &value) {
+        std::memcpy(static_cast<unsigned char *>(args) + offset, &value,
+                    sizeof(T));
+        offset += sizeof(T);
+    }
+
+    template <typename T>
+    static T load(const unsigned char *src, std::size_t &offset) {
+        T value{};
+        std::memcpy(&value, src + offset, sizeof(T));
+        offset += sizeof(T);
+        return value;
+    }
+
+    template <typename... Ts>
+    static void format_detail(std::string &out, std::string_view fmt_str,
+                              const unsigned char *src) {
+        std::size_t offset = 0;
+        // 花括号初始化保证从左到右依次读取
+        const std::tuple<Ts...> values{load<Ts>(src, offset)...};
+        std::apply(
+            [&out, fmt_str](const Ts &...value) {
+                MLogFormatter::format_to(out, fmt_str, value...);
+            },
+            values);
+    }
+};
+
+#endif  // MLOGFORMAT_H_
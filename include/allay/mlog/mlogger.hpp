@@ -3,11 +3,24 @@
 
 #include "mlogtool.hpp"
 
+#include "mlogasyncwriter.hpp"
+#include "mlogbinary.hpp"
 #include "mlogfilemanager.hpp"
+#include "mlogformat.hpp"
+#include "mlogring.hpp"
+#include "mlogsink.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 class MLogger {
 public:
@@ -15,6 +28,9 @@ public:
     using Level = MLogTool::Level;
     using Out = MLogTool::OutType;
     using Color = MLogTool::ColorType;
+    using Overflow = MLogTool::OverflowPolicy;
+    using AsyncStats = MLogAsyncWriter::Stats;
+    using Rotation = MLogFileManager::RotationPolicy;
 
     //----------------------------------------------------------------------------//
     // 直接对外暴露的接口
@@ -45,8 +61,82 @@ public:
         return if_unlock().link_file_detail(filename, std::ios_base::app);
     }
 
+    // 以二进制格式写日志文件，每次都会截断原有内容
+    // 格式字符串接口只写入格式编号和参数的原始字节，不在调用线程中格式化，
+    // 其它输出作为已经格式化的文本记录写入，可以用mlog_decode还原为文本日志
+    MLogger &link_file_binary(const std::string &file_name) {
+        return if_unlock().disable_async_detail().link_file_detail(
+            file_name, std::ios_base::trunc | std::ios_base::binary, true);
+    }
+
+    // 把日志写入固定大小的内存映射文件，作为环形缓冲区只保留最近capacity字节
+    // 写日志只是内存复制，进程崩溃或者报错退出以后仍然可以从文件中恢复，
+    // 可以用mlog_decode还原为文本日志
+    MLogger &link_file_ring(const std::string &file_name,
+                            std::size_t capacity = 4 * 1024 * 1024) {
+        return if_unlock().link_ring_detail(file_name, capacity);
+    }
+
+    // 设置日志文件的轮转策略，对当前文件和之后打开的文件都有效
+    // 轮转在写出记录的线程中进行(异步模式下是后台线程)，与记录的写出互斥，
+    // 每条记录完整地写入某一个文件，不会丢失或者重复
+    // 只统计通过记录接口写入的字节，直接对logger使用<<的内容不计入
+    MLogger &set_rotation(const Rotation &rotation) {
+        if_unlock();
+        if (m_async_writer) { m_async_writer->flush(); }
+
+        std::lock_guard<std::mutex> lock(m_record_mtx);
+        m_rotation = rotation;
+        return (*this);
+    }
+
+    // 在未锁定时添加一个附加的输出目标，与cout和日志文件同时输出
+    // 每条记录只格式化一次，依次交给所有的sink，sink各自按照自己的等级过滤
+    // 只需要sink时可以先用link_none关闭cout和日志文件
+    MLogger &add_sink(std::shared_ptr<MLogSink> sink) {
+        if_unlock();
+        if (m_async_writer) { m_async_writer->flush(); }
+
+        std::lock_guard<std::mutex> lock(m_record_mtx);
+        if (sink) {
+            m_sinks_accept_color = m_sinks_accept_color && sink->accepts_color();
+            m_sinks.push_back(std::move(sink));
+            update_sink_level();
+        }
+        return (*this);
+    }
+
+    // 在未锁定时移除所有附加的输出目标
+    MLogger &clear_sinks() {
+        if_unlock();
+        if (m_async_writer) { m_async_writer->flush(); }
+
+        std::lock_guard<std::mutex> lock(m_record_mtx);
+        m_sinks.clear();
+        m_sinks_accept_color = true;
+        update_sink_level();
+        return (*this);
+    }
+
     // Part 2. 输出开关选项修改
 
+    // 这个logger自己的日志等级，与全局等级同时满足时才输出
+    // 默认不限制，只由全局等级决定；锁定以后仍然可以修改，可以在其它线程写日志时修改
+    MLogger &set_level(Level level) {
+        m_level.store(level, std::memory_order_relaxed);
+        return (*this);
+    }
+
+    Level get_level() const { return m_level.load(std::memory_order_relaxed); }
+
+    // 判断指定等级的日志在这个logger上是否需要输出
+    // 不输出到cout和文件时，还需要有sink接受这个等级，否则不格式化记录
+    bool is_level_enabled(Level level) const {
+        return MLogTool::is_level_enabled(level)
+               && m_level.load(std::memory_order_relaxed) <= level
+               && has_destination(level);
+    }
+
     // 锁定，不可以改变输出流状态
     MLogger &lock() {
         m_lock = true;
@@ -68,6 +158,43 @@ public:
     // 在未锁定时，同时对cout和文件流输出
     MLogger &enable_file_and_cout() { return if_unlock().set_flags(Out::CF); }
 
+    // Part 3. 异步输出
+
+    // 在未锁定时开启异步模式
+    // 调用方只把记录放入有界无锁队列，由后台线程批量写入cout或文件流
+    // capacity为队列容量(记录条数)，overflow决定队列已满时的处理方式
+    // 二进制模式下调用方只复制参数，不需要后台线程，此时忽略这个选项
+    MLogger &enable_async(std::size_t capacity = 8192,
+                          Overflow overflow = Overflow::BLOCK) {
+        if_unlock().disable_async_detail();
+        if (m_binary_writer) { return (*this); }
+        m_async_writer = std::make_unique<MLogAsyncWriter>(
+            capacity, overflow,
+            [this](std::string_view batch,
+                   const std::vector<MLogAsyncWriter::RecordSpan> &spans) {
+                std::lock_guard<std::mutex> lock(m_record_mtx);
+                write_batch(batch);
+                for (const auto &span : spans) {
+                    write_sinks(span.level,
+                                batch.substr(span.begin, span.size));
+                }
+            },
+            [this](Level level) { return has_destination(level); });
+        return (*this);
+    }
+
+    // 在未锁定时关闭异步模式，关闭前会写出所有剩余记录
+    MLogger &disable_async() { return if_unlock().disable_async_detail(); }
+
+    bool is_async() const { return m_async_writer != nullptr; }
+
+    bool is_binary() const { return m_binary_writer != nullptr; }
+
+    // 异步模式的统计信息，同步模式下全部为0
+    AsyncStats get_async_stats() const {
+        return m_async_writer ? m_async_writer->get_stats() : AsyncStats{};
+    }
+
     //----------------------------------------------------------------------------//
     // 对外输出
     // 以下模板和实例化方案参考c++ primer
@@ -77,6 +204,9 @@ public:
     MLogger &operator<<(const MessageType &msg) {
         if (!m_output_flag) { return *this; }  // 永久关闭的话直接返回
 
+        // 异步模式和二进制模式下先暂存
+        if (stage_message(msg)) { return *this; }
+
         if (m_use_cout_flag) { std::cout << msg; }  // 对接到cout
         if (m_use_file_flag && (m_logfile_ofstream != nullptr)) {
             (*m_logfile_ofstream) << msg;
@@ -89,6 +219,9 @@ public:
     MLogger &operator<<(MessageType *msg_str) {
         if (!m_output_flag) { return *this; }  // 永久关闭的话直接返回
 
+        // 异步模式和二进制模式下先暂存
+        if (stage_message(*msg_str)) { return *this; }
+
         if (m_use_cout_flag) { std::cout << (*msg_str); }  // 对接到cout
         if (m_use_file_flag && (m_logfile_ofstream != nullptr)) {
             (*m_logfile_ofstream) << (*msg_str);
@@ -100,6 +233,23 @@ public:
     MLogger &operator<<(const std::string &msg_str) {
         if (!m_output_flag) { return *this; }  // 永久关闭的话直接返回
 
+        // 异步模式和二进制模式下先暂存
+        if (stage_message(msg_str)) { return *this; }
+
+        if (m_use_cout_flag) { std::cout << msg_str; }  // 对接到cout
+        if (m_use_file_flag && (m_logfile_ofstream != nullptr)) {
+            (*m_logfile_ofstream) << msg_str;
+        }  // 对接到文件流
+        return *this;
+    }
+
+    // 对于string_view，直接处理
+    MLogger &operator<<(std::string_view msg_str) {
+        if (!m_output_flag) { return *this; }  // 永久关闭的话直接返回
+
+        // 异步模式和二进制模式下先暂存
+        if (stage_message(msg_str)) { return *this; }
+
         if (m_use_cout_flag) { std::cout << msg_str; }  // 对接到cout
         if (m_use_file_flag && (m_logfile_ofstream != nullptr)) {
             (*m_logfile_ofstream) << msg_str;
@@ -107,14 +257,14 @@ public:
         return *this;
     }
 
-    // 对于char*风格的，转换成string处理
+    // 对于char*风格的，按照string_view处理，不构造临时的string
     MLogger &operator<<(char *msg_str_raw) {
-        return operator<<(std::string(msg_str_raw));
+        return operator<<(std::string_view{msg_str_raw});
     }
 
-    // 对于char*风格的，转换成string处理
+    // 对于char*风格的，按照string_view处理，不构造临时的string
     MLogger &operator<<(const char *msg_str_raw) {
-        return operator<<(std::string(msg_str_raw));
+        return operator<<(std::string_view{msg_str_raw});
     }
 
     using CoutType = std::basic_ostream<char, std::char_traits<char>>;
@@ -124,19 +274,63 @@ public:
     MLogger &operator<<(StandardEndLineType func) {
         if (!m_output_flag) { return *this; }  // 永久关闭的话直接返回
 
+        // 异步模式下std::endl只负责结束当前记录，不会等待写出
+        if (stage_message(func)) { return *this; }
+
         if (m_use_cout_flag) func(std::cout);
         if (m_use_file_flag) { func(*m_logfile_ofstream); }
 
         return *this;
     }
 
+    //----------------------------------------------------------------------------//
+    // 基于{}格式字符串的接口，整条语句作为一条记录，末尾自动换行
+    // 格式字符串在编译期检查，参数个数不一致时无法通过编译
+    // 异步模式下数值类型的参数按值保存，由后台线程在写出时再格式化
+
+    template <typename... Args>
+    void log_fmt(Level level, MLogFormatString<Args...> fmt,
+                 const Args &...args);
+
+    template <typename... Args>
+    void debug_fmt(MLogFormatString<Args...> fmt, const Args &...args) {
+        log_fmt<Args...>(Level::debug, fmt, args...);
+    }
+
+    template <typename... Args>
+    void info_fmt(MLogFormatString<Args...> fmt, const Args &...args) {
+        log_fmt<Args...>(Level::info, fmt, args...);
+    }
+
+    template <typename... Args>
+    void warn_fmt(MLogFormatString<Args...> fmt, const Args &...args) {
+        log_fmt<Args...>(Level::warn, fmt, args...);
+    }
+
+    template <typename... Args>
+    void error_fmt(MLogFormatString<Args...> fmt, const Args &...args) {
+        log_fmt<Args...>(Level::error, fmt, args...);
+    }
+
     //----------------------------------------------------------------------------//
 
     MLogger &flush() {
+        // 异步模式下先等待队列中的记录全部写出
+        if (m_async_writer) { m_async_writer->flush(); }
         // 无论是否对接到cout
         std::cout.flush();
+
+        // 与记录的写出和文件轮转互斥
+        std::lock_guard<std::mutex> lock(m_record_mtx);
+        // 二进制模式下先把暂存的内容写入文件流
+        if (m_binary_writer) {
+            m_binary_writer->commit();
+            m_binary_writer->flush();
+        }
+        if (m_ring) { m_ring->commit(); }
         // 无论flag是否对接到文件流，只要可以访问这个流
         if (m_logfile_ofstream != nullptr) { m_logfile_ofstream->flush(); }
+        for (const auto &sink : m_sinks) { sink->flush(); }
         return *this;
     }
 
@@ -172,47 +366,97 @@ public:
 
     // 可能MLogFileCenter析构在它之前，所以析构不能负责文件关闭
     // 因为只允许mloggermanager进行构造，并且单例是局部静态的，这里也同样析构只能发生在main函数之后
-    ~MLogger() { clean_file_and_ofstream(false); }
+    ~MLogger() {
+        clean_file_and_ofstream(false);
+        m_async_writer.reset();
+    }
 
     //----------------------------------------------------------------------------//
 private:
     friend class MLoggerManager;
+    friend class MLogRecord;
 
     // 核心方法，不负责检查是否锁定，这是内层方法
     // 改变文件流为其它文件流，并负责打开文件
     // 失败则绑定nullptr
     // 析构时不会负责关闭，由MLogFileManager的单例负责逐个关闭
+    // binary为true时以二进制格式写入
     MLogger &link_file_detail(const std::string &file_name,
-                              const std::ios_base::openmode mode) {
+                              const std::ios_base::openmode mode,
+                              bool binary = false) {
         // 妥善收尾
         clean_file_and_ofstream(true);
 
         auto full_file_name = MLogFileManager::get_path_prefix() + file_name;
 
         // 尝试获取新文件流，不负责检查合法性和唯一性
-        m_logfile_ofstream = MLogFileManager::get_unique_ofstream(file_name);
+        auto ofstream = MLogFileManager::get_unique_ofstream(file_name);
 
         // 没有获取到文件句柄，报错退出
-        if (!m_logfile_ofstream) {
-            set_flags(Out::C)
-                .clean_file_and_ofstream(true)
-                .notice_open_file_failed_and_exit(full_file_name);
+        if (!ofstream) {
+            set_flags(Out::C).notice_open_file_failed_and_exit(full_file_name);
         }
 
         // 获取了新的文件句柄，
         // 尝试打开文件
-        m_logfile_ofstream->open(full_file_name, std::ios_base::out | mode);
+        ofstream->open(full_file_name, std::ios_base::out | mode);
 
         // 没有打开文件，报错退出
-        if (m_logfile_ofstream->fail()) {
-            set_flags(Out::C)
-                .clean_file_and_ofstream(true)
-                .notice_open_file_failed_and_exit(full_file_name);
+        if (ofstream->fail()) {
+            MLogFileManager::erase_unique_ofstream(file_name);
+            set_flags(Out::C).notice_open_file_failed_and_exit(full_file_name);
         }
 
-        m_file_name = file_name;  // 记录更新日志文件名
-        // 成功打开新的日志文件，在写日志之前加入固定的前缀
-        return set_flags(Out::F).notice_open_file();
+        {
+            // 打开以后再交给写记录的线程
+            std::lock_guard<std::mutex> lock(m_record_mtx);
+            m_logfile_ofstream = std::move(ofstream);
+            m_file_name = file_name;  // 记录更新日志文件名
+            m_file_mode = std::ios_base::out | mode;
+            m_file_bytes = (mode & std::ios_base::app)
+                               ? MLogFileManager::file_size(full_file_name)
+                               : 0;
+            m_file_open_time = std::chrono::steady_clock::now();
+            if (binary) {
+                // 文件头需要在开头的提示之前写入
+                m_binary_writer = std::make_unique<MLogBinaryWriter>(
+                    m_logfile_ofstream, m_signature);
+            }
+            // 同步模式下在锁内写入开头的提示，不会与其它线程的记录交错
+            if (!m_async_writer) { write_file_notice(" MLOG START\n"); }
+        }
+        // 成功打开新的日志文件，异步模式下由后台线程写入开头的提示
+        set_flags(Out::F);
+        return m_async_writer ? notice_open_file() : (*this);
+    }
+
+    // 与link_file_detail类似，文件名同样由MLogFileManager占用，避免冲突
+    MLogger &link_ring_detail(const std::string &file_name,
+                              std::size_t capacity) {
+        clean_file_and_ofstream(true);
+
+        auto full_file_name = MLogFileManager::get_path_prefix() + file_name;
+
+        // 只占用文件名，不使用这个ofstream
+        if (!MLogFileManager::get_unique_ofstream(file_name)) {
+            set_flags(Out::C).notice_open_file_failed_and_exit(full_file_name);
+        }
+
+        auto ring = std::make_unique<MLogRingBuffer>(full_file_name, capacity);
+        if (!ring->is_open()) {
+            ring.reset();
+            MLogFileManager::erase_unique_ofstream(file_name);
+            set_flags(Out::C).notice_open_file_failed_and_exit(full_file_name);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_record_mtx);
+            m_ring = std::move(ring);
+            m_file_name = file_name;
+            if (!m_async_writer) { write_file_notice(" MLOG START\n"); }
+        }
+        set_flags(Out::F);
+        return m_async_writer ? notice_open_file() : (*this);
     }
 
     MLogger &log_with_color(const std::string &message, Color color) {
@@ -240,6 +484,27 @@ private:
                                    const char *color_suffix) {
         if (!m_output_flag) return (*this);
 
+        // 异步模式下cout和文件流共用同一条记录，只有单独输出到cout时才保留颜色
+        if (m_binary_writer || m_ring) {
+            if (m_use_cout_flag) {
+                std::cout << color_prefix << message << color_suffix;
+            }
+            if (m_use_file_flag) { stage_file(message); }
+            return (*this);
+        }
+
+        if (m_async_writer) {
+            if (m_use_cout_flag && !m_use_file_flag) {
+                m_async_writer->append(color_prefix);
+                m_async_writer->append(message);
+                m_async_writer->append(color_suffix);
+            }
+            else {
+                m_async_writer->append(message);
+            }
+            return (*this);
+        }
+
         if (m_use_cout_flag) {
             std::cout << color_prefix << message << color_suffix;
         }
@@ -290,9 +555,85 @@ private:
         return log_start(level, m_log_start_format);
     }
 
+    // 把日志开头按照自带的格式写入一条记录的缓冲区，不产生临时的string
+    // 同一条记录会同时写入cout、文件流和所有的sink，
+    // 只有不输出到文件流并且所有sink都接受颜色时才保留颜色
+    void format_start(std::string &buffer, Level level) const {
+        MLogTool::append_log_start(
+            buffer, level, m_log_start_format, m_signature,
+            [] { return std::chrono::system_clock::now(); },
+            !m_use_file_flag && m_sinks_accept_color
+                && (m_use_cout_flag || !m_sinks.empty()));
+    }
+
+    // 提交一条完整的记录，可以被多个线程同时调用
+    // 同步模式下对每条记录加一次锁，异步模式下直接无锁入队
+    // 异步模式下deferred中的参数由后台线程格式化，同步模式下不会出现deferred
+    void commit_record(std::string &record, Level level, bool flush_flag,
+                       const MLogDeferred *deferred = nullptr) {
+        if (m_async_writer) {
+            m_async_writer->push(record, level, deferred);
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(m_record_mtx);
+        write_batch(record);
+        write_sinks(level, record);
+        if (flush_flag) {
+            if (m_use_cout_flag) { std::cout.flush(); }
+            if (m_use_file_flag && (m_logfile_ofstream != nullptr)) {
+                m_logfile_ofstream->flush();
+            }
+            // sink按照自己的策略写出，只在flush时全部写出
+        }
+    }
+
+    // 是否有输出目标接受这个等级的记录
+    bool has_destination(Level level) const {
+        return m_use_cout_flag.load(std::memory_order_relaxed)
+               || m_use_file_flag.load(std::memory_order_relaxed)
+               || sink_level() <= level;
+    }
+
+    // 所有sink的最低等级，没有sink时为off
+    // 有sink修改过等级时加锁重新计算
+    Level sink_level() const {
+        if (MLogSink::level_epoch().load(std::memory_order_acquire)
+            != m_sink_level_epoch.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(m_record_mtx);
+            update_sink_level();
+        }
+        return m_sink_level.load(std::memory_order_relaxed);
+    }
+
+    // 调用方需要持有m_record_mtx
+    void update_sink_level() const {
+        const std::uint64_t epoch =
+            MLogSink::level_epoch().load(std::memory_order_acquire);
+        Level level = Level::off;
+        for (const auto &sink : m_sinks) {
+            level = std::min(level, sink->get_level());
+        }
+        m_sink_level.store(level, std::memory_order_relaxed);
+        m_sink_level_epoch.store(epoch, std::memory_order_relaxed);
+    }
+
+    // 把一条完整的记录交给所有满足等级的sink
+    // 调用方需要持有m_record_mtx
+    void write_sinks(Level level, std::string_view record) {
+        for (const auto &sink : m_sinks) {
+            if (sink->should_log(level)) { sink->write(level, record); }
+        }
+    }
+
     // 建议只采用cout或者file单通道输出，并且通常情况下会自动进行切换不需要设置
     // 但是这里也可以设置两个通道都输出或者都关闭
+    // 与记录的写出互斥，一批记录整体使用同一种输出方式
     MLogger &set_flags(Out out_type) {
+        // 异步模式下先写出已有记录，后台线程不会看到输出方式的变化
+        if (m_async_writer) { m_async_writer->flush(); }
+
+        std::lock_guard<std::mutex> lock(m_record_mtx);
         switch (out_type) {
         case Out::N:
             m_use_cout_flag = false;
@@ -325,30 +666,248 @@ private:
         return set_flags(out_type);
     }
 
+    // 其它线程可能同时在写记录，在m_record_mtx下取下文件，然后在锁外关闭
     MLogger &clean_file_and_ofstream(bool erase_flag) {
-        if (m_logfile_ofstream) {
-            // 关闭文件
-            if (m_logfile_ofstream->is_open()) {
-                // 正常状态就向这个文件流写入结束语
-                set_flags(Out::F).notice_close_file().set_flags(Out::C);
+        // 后台线程可能正在轮转，文件暂时处于关闭状态，先等待队列清空
+        if (m_async_writer) { m_async_writer->flush(); }
+
+        // 正常状态就向这个文件写入结束语
+        // 异步模式下交给后台线程写出并等待，同步模式下在锁内直接写入
+        if (m_async_writer && file_linked()) {
+            set_flags(Out::F).notice_close_file().set_flags(Out::C);
+            m_async_writer->flush();
+        }
 
-                m_logfile_ofstream->flush();
-                m_logfile_ofstream->close();
-            }
-            if (erase_flag) {
-                MLogFileManager::erase_unique_ofstream(
-                    m_file_name);  // 清理ofstream，在析构时不会调用，否则因为析构顺序可能有异常
+        std::unique_ptr<MLogRingBuffer> ring;
+        std::unique_ptr<MLogBinaryWriter> binary_writer;
+        std::shared_ptr<std::ofstream> ofstream;
+        std::string file_name;
+        {
+            std::lock_guard<std::mutex> lock(m_record_mtx);
+            if (!m_async_writer && file_linked()) {
+                write_file_notice(" MLOG END\n");
+                m_use_cout_flag = true;
+                m_use_file_flag = false;
             }
+            ring.swap(m_ring);
+            binary_writer.swap(m_binary_writer);
+            ofstream.swap(m_logfile_ofstream);
+            file_name.swap(m_file_name);
         }
 
-        // 清理内部数据
-        m_file_name = std::string();
-        m_logfile_ofstream = nullptr;
+        const bool linked = ring || ofstream;
+        ring.reset();
+        binary_writer.reset();  // 写出剩余的二进制记录
+        if (ofstream && ofstream->is_open()) {
+            ofstream->flush();
+            ofstream->close();
+        }
+        // 清理ofstream，在析构时不会调用，否则因为析构顺序可能有异常
+        if (linked && erase_flag) {
+            MLogFileManager::erase_unique_ofstream(file_name);
+        }
         std::cout.flush();
 
         return (*this);
     }
 
+    MLogger &disable_async_detail() {
+        if (m_async_writer) {
+            m_async_writer->flush();
+            m_async_writer.reset();
+        }
+        return (*this);
+    }
+
+    // 把一条或者一批完整的记录一次性写出
+    // 异步模式下在后台线程中调用，二进制模式下作为文本记录写入
+    void write_batch(std::string_view batch) {
+        if (m_use_cout_flag) {
+            std::cout.write(batch.data(),
+                            static_cast<std::streamsize>(batch.size()));
+        }
+        if (m_use_file_flag && m_ring) { m_ring->write(batch); }
+        else if (m_use_file_flag
+                 && (m_binary_writer || (m_logfile_ofstream != nullptr))) {
+            write_file(batch);
+        }
+    }
+
+    // 把一批记录写入文件，按照轮转策略的大小限制在行边界处切分到多个文件
+    // 调用方需要持有m_record_mtx或者处于异步模式的后台线程中
+    void write_file(std::string_view text) {
+        if (m_rotation.enabled()) {
+            if (m_file_bytes > 0 && file_expired()) { rotate_file(); }
+
+            while (m_rotation.max_bytes > 0
+                   && m_file_bytes + text.size() > m_rotation.max_bytes) {
+                // 在不超过大小限制的最后一个换行处切分
+                const std::size_t budget =
+                    (m_rotation.max_bytes > m_file_bytes)
+                        ? m_rotation.max_bytes - m_file_bytes
+                        : 0;
+                std::size_t end = (budget > 0) ? text.rfind('\n', budget - 1)
+                                               : std::string_view::npos;
+                if (end == std::string_view::npos) {
+                    if (m_file_bytes > 0) {
+                        rotate_file();
+                        continue;
+                    }
+                    // 新文件也放不下第一行时，整行写入
+                    end = text.find('\n');
+                    if (end == std::string_view::npos || end + 1 == text.size()) {
+                        break;
+                    }
+                }
+
+                write_file_detail(text.substr(0, end + 1));
+                text.remove_prefix(end + 1);
+                rotate_file();
+            }
+        }
+
+        write_file_detail(text);
+    }
+
+    void write_file_detail(std::string_view text) {
+        if (m_binary_writer) { m_binary_writer->write_text(text); }
+        else {
+            m_logfile_ofstream->write(
+                text.data(), static_cast<std::streamsize>(text.size()));
+        }
+        m_file_bytes += text.size();
+    }
+
+    // 二进制格式记录的大小在写入之前未知，只在已经超出限制时轮转
+    void prepare_binary_write() {
+        if (m_rotation.enabled() && m_file_bytes > 0
+            && ((m_rotation.max_bytes > 0
+                 && m_file_bytes >= m_rotation.max_bytes)
+                || file_expired())) {
+            rotate_file();
+        }
+    }
+
+    bool file_expired() const {
+        return m_rotation.max_age.count() > 0
+               && std::chrono::steady_clock::now() - m_file_open_time
+                      >= m_rotation.max_age;
+    }
+
+    // 交给MLogFileManager改名，打开同名的新文件以后再关闭当前文件
+    // 可能在后台线程中调用，所以开头和结尾的提示直接写入文件流，不经过<<
+    // 改名或者打开失败时只报告错误，继续追加到当前文件，
+    // 写满下一个文件的大小或者时间以后再重试
+    void rotate_file() {
+        auto full_file_name = MLogFileManager::get_path_prefix() + m_file_name;
+
+        // 先写出已有的内容，改名以后当前文件流仍然指向改名后的文件
+        if (m_binary_writer) {
+            m_binary_writer->commit();
+            m_binary_writer->flush();
+        }
+        m_logfile_ofstream->flush();
+#ifdef _WIN32
+        // Windows下不能改名已经打开的文件，只能先关闭
+        write_file_notice(" MLOG END\n");
+        m_binary_writer.reset();
+        m_logfile_ofstream->close();
+#endif
+
+        std::ofstream new_ofstream;
+        const bool rotated =
+            MLogFileManager::rotate_files(full_file_name, m_rotation.max_files);
+        if (!rotated) {
+            std::cerr << "MLog: Can not rotate file \"" << full_file_name
+                      << "\".\n";
+        }
+        else {
+            new_ofstream.open(full_file_name, m_file_mode);
+            if (new_ofstream.fail()) {
+                std::cerr << "MLog: Can not open file \"" << full_file_name
+                          << "\".\n";
+            }
+        }
+
+        m_file_bytes = 0;
+        m_file_open_time = std::chrono::steady_clock::now();
+#ifdef _WIN32
+        const bool binary = (m_file_mode & std::ios_base::binary) != 0;
+        if (!new_ofstream.is_open()) {
+            // 重新追加到保存着原来内容的文件，二进制模式下不能从中间续写
+            if (!binary) {
+                m_logfile_ofstream->open(
+                    rotated ? MLogFileManager::rotated_file_name(
+                                  full_file_name, 1)
+                            : full_file_name,
+                    (m_file_mode & ~std::ios_base::trunc)
+                        | std::ios_base::app);
+            }
+            return;
+        }
+#else
+        if (!new_ofstream.is_open()) { return; }
+
+        write_file_notice(" MLOG END\n");
+        const bool binary = (m_binary_writer != nullptr);
+        m_binary_writer.reset();  // 写出剩余的二进制记录
+        m_logfile_ofstream->flush();
+#endif
+        // 文件流由MLogFileManager持有，只替换其中的文件
+        *m_logfile_ofstream = std::move(new_ofstream);
+
+        if (binary) {
+            m_binary_writer = std::make_unique<MLogBinaryWriter>(
+                m_logfile_ofstream, m_signature);
+        }
+        write_file_notice(" MLOG START\n");
+    }
+
+    // 是否对接到可以写入的日志文件
+    bool file_linked() const {
+        return m_ring || (m_logfile_ofstream && m_logfile_ofstream->is_open());
+    }
+
+    // 直接向日志文件写入一行提示，日志等级off，日志戳为等级和签名和时间
+    void write_file_notice(std::string_view message) {
+        std::string text;
+        MLogTool::append_log_start(
+            text, Level::off, Format::LEVEL_SIGNATURE_TIME, m_signature,
+            [] { return std::chrono::system_clock::now(); }, false);
+        text += message;
+
+        if (m_ring) { m_ring->write(text); }
+        else if (m_binary_writer) { m_binary_writer->write_text(text); }
+        else {
+            m_logfile_ofstream->write(
+                text.data(), static_cast<std::streamsize>(text.size()));
+        }
+    }
+
+    // 异步模式和二进制模式下直接对logger使用<<时，先暂存到当前行
+    // 返回true表示已经处理，否则由调用方直接写出
+    template <typename MessageType>
+    bool stage_message(const MessageType &msg) {
+        if (m_async_writer) {
+            m_async_writer->append(msg);
+            return true;
+        }
+
+        if (m_binary_writer || m_ring) {
+            if (m_use_cout_flag) { std::cout << msg; }
+            if (m_use_file_flag) { stage_file(msg); }
+            return true;
+        }
+
+        return false;
+    }
+
+    template <typename MessageType>
+    void stage_file(const MessageType &msg) {
+        if (m_binary_writer) { m_binary_writer->append(msg); }
+        else { m_ring->append(msg); }
+    }
+
     // 如果被锁定就报错退出，否则返回自身
     MLogger &if_unlock() {
         if (m_lock) notice_locked_and_exit();
@@ -358,8 +917,10 @@ private:
     std::string m_name;           // 自己的名字
     std::string m_signature;      // 签名，比名字多了个{}
     bool m_output_flag{true};     // 是否直接关闭所有输出
-    bool m_use_cout_flag{true};   // 是否使用cout
-    bool m_use_file_flag{false};  // 是否使用文件流
+    std::atomic<Level> m_level{Level::on};  // 自己的日志等级
+    // 调用线程在锁外读取，只在m_record_mtx下修改
+    std::atomic_bool m_use_cout_flag{true};   // 是否使用cout
+    std::atomic_bool m_use_file_flag{false};  // 是否使用文件流
     std::shared_ptr<std::ofstream>
         m_logfile_ofstream;  // 指针可以空但是引用必须初始化并且无法改变
     std::string
@@ -367,6 +928,19 @@ private:
     bool m_lock{false};  // 加锁后只可以使用输出，不能用对外接口改变输出方式
     Format m_log_start_format{
         Format::LEVEL_SIGNATURE};  // 普通日志默认使用的开头格式
+    std::unique_ptr<MLogAsyncWriter> m_async_writer;  // 非空时处于异步模式
+    std::unique_ptr<MLogBinaryWriter> m_binary_writer;  // 非空时处于二进制模式
+    std::unique_ptr<MLogRingBuffer> m_ring;  // 非空时写入环形日志文件
+    mutable std::mutex m_record_mtx;  // 保证每条记录整体写出，与文件轮转互斥
+    Rotation m_rotation;      // 日志文件的轮转策略
+    std::ios_base::openmode m_file_mode{std::ios_base::out};  // 轮转后重新打开
+    std::uintmax_t m_file_bytes{0};  // 当前文件已经写入的字节数
+    std::chrono::steady_clock::time_point m_file_open_time;  // 当前文件的打开时间
+    std::vector<std::shared_ptr<MLogSink>> m_sinks;  // 附加的输出目标
+    bool m_sinks_accept_color{true};  // 所有的sink都接受带颜色的记录
+    // 所有sink的最低等级，以及计算时sink等级的修改次数
+    mutable std::atomic<Level> m_sink_level{Level::off};
+    mutable std::atomic<std::uint64_t> m_sink_level_epoch{0};
 
     //----------------------------------------------------------------------------//
 
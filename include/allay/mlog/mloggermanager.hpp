@@ -3,7 +3,17 @@
 
 #include "mlogger.hpp"
 
+#include "mlogprofile.hpp"
+#include "mlogrecord.hpp"
+
+#include <algorithm>
+#include <cstddef>
 #include <filesystem>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 // 负责日志等级判定
 class MLoggerManager {
@@ -20,33 +30,36 @@ public:
     // 通过注册map保存
     // 对已经存在的直接报错
     static MLogger &create_logger(const std::string &logger_name) {
-        // 如果logger已经存在则报错结束
-        if (logger_map().find(logger_name) != logger_map().end()) {
-            logger_map()["cout"].log_start(Level::on,
-                                           Format::LEVEL_SIGNATURE_TIME)
-                << " The logger named \"" << logger_name
-                << "\" already exists. Can not create it again.)\n";
-
-            MLogTool::raise_error();
-        }
-
         // 检查名称的合法性
         // 如果空字符串或者名称不合法，报错
         if (logger_name.empty()
             || !MLogTool::check_filename_valid(logger_name)) {
-            logger_map()["cout"].notice_invalid_name_and_exit(logger_name);
+            get_logger_cout().notice_invalid_name_and_exit(logger_name);
         }
 
-        return logger_map()[logger_name].init_register(logger_name, true,
-                                                       OutType::C);
+        // 只做一次哈希查找，如果logger已经存在则报错结束
+        auto [iter, inserted] = logger_map().try_emplace(logger_name);
+        if (!inserted) {
+            get_logger_cout().log_start(Level::on,
+                                        Format::LEVEL_SIGNATURE_TIME)
+                << " The logger named \"" << logger_name
+                << "\" already exists. Can not create it again.)\n";
+
+            MLogTool::raise_error();
+        }
+
+        return iter->second.init_register(logger_name, true, OutType::C);
     }
 
     // 如果没有在map找到，不会自动新建
-    static MLogger &get_logger(const std::string &logger_name) {
+    // 只做一次哈希查找，不构造临时的string；频繁使用时建议缓存MLogHandle
+    static MLogger &get_logger(std::string_view logger_name) {
+        auto iter = logger_map().find(logger_name);
+
         // 如果没有在map找到，不会自动新建，报错结束
-        if (logger_map().find(logger_name) == logger_map().end()) {
-            logger_map()["cout"].log_start(Level::on,
-                                           Format::LEVEL_SIGNATURE_TIME)
+        if (iter == logger_map().end()) {
+            get_logger_cout().log_start(Level::on,
+                                        Format::LEVEL_SIGNATURE_TIME)
                 << " Can not find a logger named \"" << logger_name
                 << "\". Please create it. (Maybe you forgot to use "
                    "MLog::init().)\n";
@@ -54,34 +67,46 @@ public:
             MLogTool::raise_error();
         }
 
-        return logger_map().find(logger_name)->second;
+        return iter->second;
     }
 
     //----------------------------------------------------------------------------//
 
     // 标准MLogger对象cout，向cout输出
-    static MLogger &get_logger_cout() { return logger_map()["cout"]; }
+    // logger不会被删除，元素的引用一直有效，因此只需要查找一次
+    static MLogger &get_logger_cout() {
+        static MLogger &the_logger_cout = logger_map()["cout"];
+        return the_logger_cout;
+    }
 
     // 标准MLogger对象__none__，关闭所有输出
-    static MLogger &get_logger_none() { return logger_map()["__none__"]; }
+    static MLogger &get_logger_none() {
+        static MLogger &the_logger_none = logger_map()["__none__"];
+        return the_logger_none;
+    }
 
     //----------------------------------------------------------------------------//
 
-    // 如果满足条件返回MLogger单例cout，自动加标签
-    // 否则返回MLogger单例__none__
-    static MLogger &get_logger_when(Level level) {
-        return (MLogTool::get_level_instance() <= level)
-                   ? get_logger_cout().log_start(level)
-                   : get_logger_none();
+    // 如果满足条件返回一条对接到MLogger单例cout的记录，自动加标签
+    // 否则返回一条空记录，不产生任何输出
+    static MLogRecord get_logger_when(Level level) {
+        return get_logger_when(level, get_logger_cout());
+    }
+
+    // 如果满足条件返回一条对接到指定名称的logger对象的记录，自动加标签
+    // 否则返回一条空记录，不产生任何输出
+    // 不满足全局等级时不会查找logger
+    static MLogRecord get_logger_when(Level level,
+                                      std::string_view logger_name) {
+        if (!MLogTool::is_level_enabled(level)) { return MLogRecord{}; }
+        return get_logger_when(level, get_logger(logger_name));
     }
 
-    // 如果满足条件返回指定名称的logger对象，自动加标签
-    // 否则返回MLogger单例__none__
-    static MLogger &get_logger_when(Level level,
-                                    const std::string &logger_name) {
-        return (MLogTool::get_level_instance() <= level)
-                   ? get_logger(logger_name).log_start(level)
-                   : get_logger_none();
+    static MLogRecord get_logger_when(Level level, MLogger &logger) {
+        if (logger.is_level_enabled(level)) {
+            return MLogRecord{logger, level};
+        }
+        return MLogRecord{};
     }
 
     //----------------------------------------------------------------------------//
@@ -90,12 +115,12 @@ public:
     // 创建cout和__none__两个默认logger对象，并完成相关设置然后锁定
     // 接收并记录一下日志文件的路径前缀
     static void init(const std::string &path_prefix) {
-        logger_map()["cout"]
+        get_logger_cout()
             .init_register("cout", true, OutType::C)
             .set_format(Format::LEVEL_COLOR)
             .lock();
 
-        logger_map()["__none__"]
+        get_logger_none()
             .init_register("__none__", false, OutType::C)
             .lock();
 
@@ -119,15 +144,28 @@ public:
         get_logger_cout().log_start(Level::info)
             << " log file dir: " << MLogFileManager::get_path_prefix() << '\n';
 
-        // 遍历所有拥有文件流的logger
-        auto iter = logger_map().begin();
-        while (iter != logger_map().end()) {
-            if (iter->second.m_logfile_ofstream) {
-                get_logger_cout().log_start(Level::info)
-                    << " log file: " << iter->second.m_file_name
-                    << ", owner: " << iter->second.m_name << '\n';
-            }
-            ++iter;
+        // 遍历所有拥有文件的logger，按照名称排序
+        std::vector<const MLogger *> loggers;
+        for (const auto &[name, logger] : logger_map()) {
+            if (!logger.m_file_name.empty()) { loggers.push_back(&logger); }
+        }
+        std::ranges::sort(loggers, {}, &MLogger::m_name);
+
+        for (const auto *logger : loggers) {
+            get_logger_cout().log_start(Level::info)
+                << " log file: " << logger->m_file_name
+                << ", owner: " << logger->m_name << '\n';
+        }
+
+        // 定义了MLOG_PROFILE时，按照写出的字节数列出各处日志语句
+        const auto entries = MLogProfiler::get_entries();
+        if (!entries.empty()) {
+            get_logger_cout().log_start(Level::info) << " log profile:\n";
+        }
+        for (std::size_t i = 0; i < entries.size(); ++i) {
+            get_logger_cout().log_start(Level::info)
+                << ' ' << MLogProfiler::format_entry(i + 1, entries[i])
+                << '\n';
         }
 
         get_logger_cout().log_start(Level::off) << '\n';
@@ -137,17 +175,30 @@ public:
 
 private:
     // 禁止从外部尝试构造，并且只允许static方法访问实例
-    MLoggerManager() = default;
+    // 先构造MLogFileManager的单例，使它在所有logger以及logger持有的sink之后析构
+    MLoggerManager() { MLogFileManager::get_path_prefix(); }
     ~MLoggerManager() = default;
 
+    // 支持直接用string_view查找，不构造临时的string
+    struct NameHash {
+        using is_transparent = void;
+
+        std::size_t operator()(std::string_view name) const {
+            return std::hash<std::string_view>{}(name);
+        }
+    };
+
+    using LoggerMap =
+        std::unordered_map<std::string, MLogger, NameHash, std::equal_to<>>;
+
     // 获取唯一实例的map
-    static std::map<const std::string, MLogger> &logger_map() {
+    static LoggerMap &logger_map() {
         static MLoggerManager the_logger_manager;
         return the_logger_manager.m_logger_map;
     }
 
-    // 基于map存储logger，必须具名
-    std::map<const std::string, MLogger> m_logger_map;
+    // 基于哈希表存储logger，必须具名；元素的引用在插入新元素以后仍然有效
+    LoggerMap m_logger_map;
 };
 
 #endif  // MLOGGERMANAGER_H_
@@ -0,0 +1,68 @@
+#ifndef MLOGHANDLE_H_
+#define MLOGHANDLE_H_
+
+#include "mlogtool.hpp"
+
+#include "mlogformat.hpp"
+#include "mlogger.hpp"
+#include "mlogrecord.hpp"
+
+// logger的句柄，只是一个指针，可以复制和缓存
+// 通过句柄写日志不需要按名称查找logger，例如
+//   static MLogHandle log_a = mlog::create_logger("A").link_file_default();
+//   log_a.info() << "x = " << x << '\n';
+//   MLOG_INFO(log_a) << "x = " << x << '\n';
+// logger一旦创建就不会被删除，所以句柄一直有效
+class MLogHandle {
+public:
+    using Level = MLogTool::Level;
+
+    // 可以由MLogger隐式转换，create_logger以及各种链式调用的结果可以直接保存为句柄
+    MLogHandle(MLogger &logger) : m_logger(&logger) {}  // NOLINT
+
+    MLogRecord debug() const { return record(Level::debug); }
+
+    MLogRecord info() const { return record(Level::info); }
+
+    MLogRecord warn() const { return record(Level::warn); }
+
+    MLogRecord error() const { return record(Level::error); }
+
+    template <typename... Args>
+    void debug_fmt(MLogFormatString<Args...> fmt, const Args &...args) const {
+        m_logger->log_fmt<Args...>(Level::debug, fmt, args...);
+    }
+
+    template <typename... Args>
+    void info_fmt(MLogFormatString<Args...> fmt, const Args &...args) const {
+        m_logger->log_fmt<Args...>(Level::info, fmt, args...);
+    }
+
+    template <typename... Args>
+    void warn_fmt(MLogFormatString<Args...> fmt, const Args &...args) const {
+        m_logger->log_fmt<Args...>(Level::warn, fmt, args...);
+    }
+
+    template <typename... Args>
+    void error_fmt(MLogFormatString<Args...> fmt, const Args &...args) const {
+        m_logger->log_fmt<Args...>(Level::error, fmt, args...);
+    }
+
+    // 访问logger本身，例如修改日志等级
+    MLogger &logger() const { return *m_logger; }
+
+    MLogger *operator->() const { return m_logger; }
+
+    // 满足全局等级和logger自己的等级时返回一条记录，否则返回空记录
+    MLogRecord record(Level level) const {
+        if (m_logger->is_level_enabled(level)) {
+            return MLogRecord{*m_logger, level};
+        }
+        return MLogRecord{};
+    }
+
+private:
+    MLogger *m_logger;
+};
+
+#endif  // MLOGHANDLE_H_
@@ -0,0 +1,211 @@
+#ifndef MLOGPROFILE_H_
+#define MLOGPROFILE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <source_location>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// 日志语句的统计，用于找出哪些日志语句占用了最多的输出
+// 在包含头文件之前定义MLOG_PROFILE时，每一处MLOG_XXX宏统计
+// 产生的记录数、被过滤的次数、写出的字节数以及整条语句的耗时
+// 没有定义时宏的展开与原来完全相同，没有任何开销
+
+// 一处日志语句的计数器，作为宏中的局部静态变量
+// 只包含原子计数器，可以平凡析构，程序退出时的汇总仍然可以安全读取
+class MLogProfileSite {
+public:
+    explicit MLogProfileSite(const std::source_location &location);
+
+    void add_filtered() { m_filtered.fetch_add(1, std::memory_order_relaxed); }
+
+    void add_record(std::size_t bytes, std::uint64_t nanoseconds) {
+        m_records.fetch_add(1, std::memory_order_relaxed);
+        m_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        m_nanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+    }
+
+    const std::source_location &location() const { return m_location; }
+
+    std::uint64_t get_records() const {
+        return m_records.load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t get_filtered() const {
+        return m_filtered.load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t get_bytes() const {
+        return m_bytes.load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t get_nanoseconds() const {
+        return m_nanoseconds.load(std::memory_order_relaxed);
+    }
+
+private:
+    const std::source_location m_location;
+    std::atomic<std::uint64_t> m_records{0};
+    std::atomic<std::uint64_t> m_filtered{0};
+    std::atomic<std::uint64_t> m_bytes{0};
+    std::atomic<std::uint64_t> m_nanoseconds{0};
+};
+
+static_assert(std::is_trivially_destructible_v<MLogProfileSite>);
+
+// 所有日志语句的统计汇总
+class MLogProfiler {
+public:
+    // 某一时刻一处日志语句的统计结果
+    struct Entry {
+        std::source_location location;
+        std::uint64_t records{0};
+        std::uint64_t filtered{0};
+        std::uint64_t bytes{0};
+        std::uint64_t nanoseconds{0};
+    };
+
+    MLogProfiler(const MLogProfiler &) = delete;
+    MLogProfiler &operator=(const MLogProfiler &) = delete;
+
+    static void register_site(MLogProfileSite &site) {
+        auto &profiler = get_instance();
+        std::lock_guard<std::mutex> lock(profiler.m_mtx);
+        profiler.m_sites.push_back(&site);
+    }
+
+    // 按照写出的字节数从多到少排序，字节数相同时按照耗时排序
+    static std::vector<Entry> get_entries() {
+        auto &profiler = get_instance();
+        std::vector<Entry> entries;
+        {
+            std::lock_guard<std::mutex> lock(profiler.m_mtx);
+            entries.reserve(profiler.m_sites.size());
+            for (const auto *site : profiler.m_sites) {
+                entries.push_back({site->location(), site->get_records(),
+                                   site->get_filtered(), site->get_bytes(),
+                                   site->get_nanoseconds()});
+            }
+        }
+
+        std::ranges::sort(entries, [](const Entry &a, const Entry &b) {
+            return (a.bytes != b.bytes) ? (a.bytes > b.bytes)
+                                        : (a.nanoseconds > b.nanoseconds);
+        });
+        return entries;
+    }
+
+    // 表格中的一行，不含换行
+    static std::string format_entry(std::size_t rank, const Entry &entry) {
+        const std::uint64_t average =
+            (entry.records > 0) ? entry.nanoseconds / entry.records : 0;
+        return "#" + std::to_string(rank) + " records "
+               + std::to_string(entry.records) + ", filtered "
+               + std::to_string(entry.filtered) + ", bytes "
+               + std::to_string(entry.bytes) + ", time "
+               + std::to_string(entry.nanoseconds / 1000) + " us, avg "
+               + std::to_string(average) + " ns, "
+               + entry.location.file_name() + ":"
+               + std::to_string(entry.location.line());
+    }
+
+    // 程序退出时向cerr输出统计表格，此时logger可能已经析构，不经过logger
+    static void set_show_at_exit(bool flag) {
+        get_instance().m_show_at_exit.store(flag, std::memory_order_relaxed);
+    }
+
+    // 每条日志语句的线程局部标记，记录提交时写入字节数，语句结束时读取并清除
+    constexpr static std::size_t no_record = static_cast<std::size_t>(-1);
+
+    static std::size_t &last_record_bytes() {
+        thread_local std::size_t the_last_record_bytes = no_record;
+        return the_last_record_bytes;
+    }
+
+private:
+    MLogProfiler() = default;
+
+    ~MLogProfiler() {
+        if (!m_show_at_exit.load(std::memory_order_relaxed)) { return; }
+
+        const auto entries = get_entries();
+        std::cerr << "MLOG PROFILE\n";
+        for (std::size_t i = 0; i < entries.size(); ++i) {
+            std::cerr << format_entry(i + 1, entries[i]) << '\n';
+        }
+    }
+
+    static MLogProfiler &get_instance() {
+        static MLogProfiler the_profiler;
+        return the_profiler;
+    }
+
+    std::mutex m_mtx;
+    std::vector<MLogProfileSite *> m_sites;
+    std::atomic_bool m_show_at_exit{false};
+};
+
+inline MLogProfileSite::MLogProfileSite(const std::source_location &location)
+    : m_location(location) {
+    MLogProfiler::register_site(*this);
+}
+
+// 一条日志语句的计时，作为宏中条件表达式里的临时对象，
+// 在记录提交以后才析构，因此统计的是整条语句(拼接、格式化和写出)的耗时
+class MLogProfileScope {
+public:
+    explicit MLogProfileScope(MLogProfileSite &site) : m_site(site) {}
+
+    ~MLogProfileScope() {
+        if (!m_started) { return; }
+
+        const auto elapsed = std::chrono::steady_clock::now() - m_start;
+        auto &bytes = MLogProfiler::last_record_bytes();
+        if (bytes == MLogProfiler::no_record) {
+            // 全局等级满足但是被logger自己的等级过滤
+            m_site.add_filtered();
+            return;
+        }
+
+        m_site.add_record(
+            bytes,
+            static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                    .count()));
+        bytes = MLogProfiler::no_record;
+    }
+
+    MLogProfileScope(const MLogProfileScope &) = delete;
+    MLogProfileScope &operator=(const MLogProfileScope &) = delete;
+    MLogProfileScope(MLogProfileScope &&) = delete;
+    MLogProfileScope &operator=(MLogProfileScope &&) = delete;
+
+    // 返回enabled，不满足等级时只计数，不读取时钟
+    // 已经开始以后再次调用返回false，MLOG_XXX宏的外层循环因此只执行一次
+    bool start(bool enabled) {
+        if (m_started) { return false; }
+        if (!enabled) {
+            m_site.add_filtered();
+            return false;
+        }
+
+        MLogProfiler::last_record_bytes() = MLogProfiler::no_record;
+        m_started = true;
+        m_start = std::chrono::steady_clock::now();
+        return true;
+    }
+
+private:
+    MLogProfileSite &m_site;
+    bool m_started{false};
+    std::chrono::steady_clock::time_point m_start;
+};
+
+#endif  // MLOGPROFILE_H_
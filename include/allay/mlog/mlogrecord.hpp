@@ -0,0 +1,209 @@
+#ifndef MLOGRECORD_H_
+#define MLOGRECORD_H_
+
+#include "mlogtool.hpp"
+
+#include "mlogformat.hpp"
+#include "mlogger.hpp"
+#include "mlogprofile.hpp"
+
+#include <cstddef>
+#include <deque>
+#include <ios>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+// 一条日志语句对应的临时对象
+// 例如 MLOG_INFO("A") << a << b; 整条语句先在当前线程的缓冲区中拼接，
+// 语句结束时临时对象析构，作为一条完整的记录一次性提交给logger
+// 整个过程中只在提交时对logger加一次锁(异步模式下是无锁入队)
+// 当日志等级不满足时，logger为空，所有的<<操作什么也不做
+class MLogRecord {
+public:
+    using Level = MLogTool::Level;
+
+    // 不输出的空记录
+    // 不使用=default，避免MLogRecord{}把延迟格式化的参数区也清零
+    MLogRecord() {}  // NOLINT(modernize-use-equals-default)
+
+    MLogRecord(MLogger &logger, Level level) {
+        if (!logger.m_output_flag) { return; }
+
+        m_logger = &logger;
+        m_level = level;
+        m_slot = &acquire_slot();
+        m_logger->format_start(m_slot->buffer, level);
+    }
+
+    // 空记录只有一次判断，可以被内联
+    ~MLogRecord() {
+        if (m_slot != nullptr) { commit(); }
+    }
+
+    MLogRecord(const MLogRecord &) = delete;
+    MLogRecord &operator=(const MLogRecord &) = delete;
+    MLogRecord(MLogRecord &&) = delete;
+    MLogRecord &operator=(MLogRecord &&) = delete;
+
+    // 空记录不会输出，MLOG_XXX宏据此跳过后面参数的求值
+    bool is_empty() const { return m_slot == nullptr; }
+
+    // 立即提交，之后成为空记录，用于结束MLOG_XXX宏中只执行一次的循环
+    void finish() {
+        if (m_slot != nullptr) {
+            commit();
+            m_slot = nullptr;
+        }
+    }
+
+    // 这个最通用模板负责所有无法处理的类型
+    template <typename MessageType>
+    MLogRecord &operator<<(const MessageType &msg) {
+        if (m_slot != nullptr) { m_slot->stream << msg; }
+        return *this;
+    }
+
+    // 对于一般的指针，打印它的内容
+    template <typename MessageType>
+    MLogRecord &operator<<(MessageType *msg_str) {
+        if (m_slot != nullptr) { m_slot->stream << (*msg_str); }
+        return *this;
+    }
+
+    // 对于字符串，直接追加到缓冲区，不产生临时的string
+    MLogRecord &operator<<(const std::string &msg_str) {
+        if (m_slot != nullptr) { m_slot->buffer += msg_str; }
+        return *this;
+    }
+
+    MLogRecord &operator<<(std::string_view msg_str) {
+        if (m_slot != nullptr) { m_slot->buffer += msg_str; }
+        return *this;
+    }
+
+    // 源代码位置直接格式化到缓冲区
+    MLogRecord &operator<<(const MLogTool::SourceStamp &stamp) {
+        if (m_slot != nullptr) { stamp.append_to(m_slot->buffer); }
+        return *this;
+    }
+
+    MLogRecord &operator<<(char ch) {
+        if (m_slot != nullptr) { m_slot->buffer += ch; }
+        return *this;
+    }
+
+    MLogRecord &operator<<(char *msg_str_raw) {
+        if (m_slot != nullptr) { m_slot->buffer += msg_str_raw; }
+        return *this;
+    }
+
+    MLogRecord &operator<<(const char *msg_str_raw) {
+        if (m_slot != nullptr) { m_slot->buffer += msg_str_raw; }
+        return *this;
+    }
+
+    // 为了支持std::endl的额外处理，提交之后会刷新输出流
+    MLogRecord &operator<<(MLogger::StandardEndLineType func) {
+        if (m_slot != nullptr) {
+            func(m_slot->stream);
+            m_flush = true;
+        }
+        return *this;
+    }
+
+    bool enabled() const { return m_slot != nullptr; }
+
+private:
+    friend class MLogger;
+
+    void commit() {
+#ifdef MLOG_PROFILE
+        MLogProfiler::last_record_bytes() = m_slot->buffer.size();
+#endif
+        m_logger->commit_record(m_slot->buffer, m_level, m_flush,
+                                (m_deferred.format != nullptr) ? &m_deferred
+                                                               : nullptr);
+        release_slot();
+    }
+
+    // 按照格式字符串追加整条消息，末尾自动换行
+    // 异步模式下如果参数都可以按值保存，则延迟到后台线程格式化
+    template <typename... Args>
+    void format(std::string_view fmt, const Args &...args) {
+        if (m_slot == nullptr) { return; }
+
+        if constexpr (MLogDeferred::can_defer<Args...>) {
+            if (m_logger->is_async()) {
+                m_deferred.capture(fmt, args...);
+                return;
+            }
+        }
+
+        m_slot->buffer += ' ';
+        MLogFormatter::format_to(m_slot->buffer, fmt, args...);
+        m_slot->buffer += '\n';
+    }
+
+    // 每个线程持有一组可复用的缓冲区和对应的ostream
+    // 日志语句中可能嵌套另一条日志语句，所以按照深度分配，deque保证引用不失效
+    struct Slot {
+        std::string buffer;
+        MLogTool::StringBuf buf{buffer};
+        std::ostream stream{&buf};
+    };
+
+    struct SlotStack {
+        std::deque<Slot> slots;
+        std::size_t depth{0};
+    };
+
+    static SlotStack &get_slot_stack() {
+        thread_local SlotStack the_slot_stack;
+        return the_slot_stack;
+    }
+
+    static Slot &acquire_slot() {
+        auto &stack = get_slot_stack();
+        if (stack.depth == stack.slots.size()) { stack.slots.emplace_back(); }
+
+        auto &slot = stack.slots[stack.depth++];
+        slot.buffer.clear();
+        // 上一条记录中可能修改了格式，这里恢复默认状态
+        slot.stream.flags(std::ios_base::dec | std::ios_base::skipws);
+        slot.stream.precision(6);
+        slot.stream.width(0);
+        slot.stream.fill(' ');
+        return slot;
+    }
+
+    static void release_slot() { --get_slot_stack().depth; }
+
+    MLogger *m_logger{nullptr};
+    Slot *m_slot{nullptr};
+    Level m_level{Level::off};
+    bool m_flush{false};
+    MLogDeferred m_deferred;  // NOLINT(cppcoreguidelines-pro-type-member-init)
+};
+
+template <typename... Args>
+void MLogger::log_fmt(Level level, MLogFormatString<Args...> fmt,
+                      const Args &...args) {
+    if (!is_level_enabled(level)) { return; }
+
+    // 只写二进制文件时，只记录格式编号和参数的原始字节
+    if constexpr (MLogBinary::can_encode<Args...>) {
+        if (m_binary_writer && m_output_flag && m_use_file_flag
+            && !m_use_cout_flag && m_sinks.empty()) {
+            std::lock_guard<std::mutex> lock(m_record_mtx);
+            prepare_binary_write();
+            m_file_bytes += m_binary_writer->write_format(
+                level, m_log_start_format, fmt.get(), args...);
+            return;
+        }
+    }
+
+    MLogRecord{*this, level}.format(fmt.get(), args...);
+}
+
+#endif  // MLOGRECORD_H_
@@ -0,0 +1,242 @@
+#ifndef MLOGRING_H_
+#define MLOGRING_H_
+
+#include "mlogtool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <new>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#ifdef _WIN32
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <windows.h>
+
+#else
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#endif
+
+// 环形日志文件的格式
+//
+// 文件头(64字节):
+//   char[8]  magic "MLOGRING"
+//   u32      版本号
+//   u32      文件头大小
+//   u64      数据区的字节数
+//   u64      累计写入的字节数，数据区中的位置是对容量取余
+// 之后是数据区，按照环形缓冲区保存最近写入的文本
+class MLogRing {
+public:
+    constexpr static char magic[8] = {'M', 'L', 'O', 'G', 'R', 'I', 'N', 'G'};
+    constexpr static std::uint32_t version = 1;
+
+    struct Header {
+        char magic[8];  // NOLINT
+        std::uint32_t version;
+        std::uint32_t header_size;
+        std::uint64_t capacity;
+        std::atomic<std::uint64_t> write_pos;
+        char reserved[32];  // NOLINT
+    };
+
+    static_assert(sizeof(Header) == 64);
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free);
+};
+
+// 写入端，把文件映射到内存中作为环形缓冲区，写日志只是内存复制，没有系统调用
+// 映射是共享的，进程崩溃或者exit以后内容仍然由操作系统写回文件
+// 同一时刻只能有一个线程写入，由调用方负责加锁
+class MLogRingBuffer {
+public:
+    // 打开失败时is_open返回false
+    MLogRingBuffer(const std::string &full_file_name, std::size_t capacity)
+        : m_capacity(std::max<std::size_t>(capacity, 1)) {
+        const std::size_t size = sizeof(MLogRing::Header) + m_capacity;
+        if (!map_file(full_file_name, size)) { return; }
+
+        m_header = new (m_mapped) MLogRing::Header{};
+        m_data = static_cast<char *>(m_mapped) + sizeof(MLogRing::Header);
+
+        std::memcpy(static_cast<char *>(m_header->magic),
+                    static_cast<const char *>(MLogRing::magic),
+                    sizeof(MLogRing::magic));
+        m_header->version = MLogRing::version;
+        m_header->header_size = sizeof(MLogRing::Header);
+        m_header->capacity = m_capacity;
+    }
+
+    MLogRingBuffer(const MLogRingBuffer &) = delete;
+    MLogRingBuffer &operator=(const MLogRingBuffer &) = delete;
+
+    ~MLogRingBuffer() {
+        commit();
+        unmap_file();
+    }
+
+    bool is_open() const { return m_header != nullptr; }
+
+    // 写入一段完整的文本，超过容量时只保留最后的部分
+    // 先复制内容再更新写入位置，读取时以写入位置为准
+    void write(std::string_view text) {
+        if (m_header == nullptr || text.empty()) { return; }
+        if (text.size() > m_capacity) {
+            text.remove_prefix(text.size() - m_capacity);
+        }
+
+        const std::uint64_t pos =
+            m_header->write_pos.load(std::memory_order_relaxed);
+        const auto offset = static_cast<std::size_t>(pos % m_capacity);
+        const std::size_t first = std::min(text.size(), m_capacity - offset);
+        std::memcpy(m_data + offset, text.data(), first);
+        std::memcpy(m_data, text.data() + first, text.size() - first);
+
+        m_header->write_pos.store(pos + text.size(), std::memory_order_release);
+    }
+
+    // 直接对logger使用<<时，先暂存到当前行，遇到换行时写入
+    template <typename MessageType>
+    void append(const MessageType &msg) {
+        m_line_stream << msg;
+        if (!m_line.empty() && m_line.back() == '\n') { commit(); }
+    }
+
+    void commit() {
+        write(m_line);
+        m_line.clear();
+    }
+
+private:
+#ifdef _WIN32
+    bool map_file(const std::string &full_file_name, std::size_t size) {
+        HANDLE file = CreateFileA(full_file_name.c_str(),
+                                  GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+                                  nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL,
+                                  nullptr);
+        if (file == INVALID_HANDLE_VALUE) { return false; }
+
+        const auto size64 = static_cast<std::uint64_t>(size);
+        HANDLE mapping = CreateFileMappingA(
+            file, nullptr, PAGE_READWRITE, static_cast<DWORD>(size64 >> 32),
+            static_cast<DWORD>(size64 & 0xFFFFFFFF), nullptr);
+        CloseHandle(file);
+        if (mapping == nullptr) { return false; }
+
+        // 映射视图会保持对文件的引用，句柄可以直接关闭
+        m_mapped = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size);
+        CloseHandle(mapping);
+        m_mapped_size = size;
+        return m_mapped != nullptr;
+    }
+
+    void unmap_file() {
+        if (m_mapped != nullptr) { UnmapViewOfFile(m_mapped); }
+        m_mapped = nullptr;
+    }
+#else
+    bool map_file(const std::string &full_file_name, std::size_t size) {
+        const int fd =
+            ::open(full_file_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) { return false; }
+
+        if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            ::close(fd);
+            return false;
+        }
+
+        // 映射会保持对文件的引用，文件描述符可以直接关闭
+        void *mapped =
+            ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) { return false; }
+
+        m_mapped = mapped;
+        m_mapped_size = size;
+        return true;
+    }
+
+    void unmap_file() {
+        if (m_mapped != nullptr) { ::munmap(m_mapped, m_mapped_size); }
+        m_mapped = nullptr;
+    }
+#endif
+
+    const std::size_t m_capacity;
+    void *m_mapped{nullptr};
+    std::size_t m_mapped_size{0};
+    MLogRing::Header *m_header{nullptr};
+    char *m_data{nullptr};
+
+    std::string m_line;
+    MLogTool::StringBuf m_line_buf{m_line};
+    std::ostream m_line_stream{&m_line_buf};
+};
+
+// 读取端，把环形日志文件按照写入顺序还原为文本
+// 发生过回绕时，最早的一行可能被覆盖了一部分，从第一个完整的行开始输出
+class MLogRingReader {
+public:
+    // 格式错误时返回false
+    static bool decode(std::istream &in, std::ostream &out) {
+        char magic[sizeof(MLogRing::magic)]{};
+        in.read(static_cast<char *>(magic), sizeof(magic));
+        if (!in
+            || std::memcmp(static_cast<char *>(magic),
+                           static_cast<const char *>(MLogRing::magic),
+                           sizeof(magic))
+                   != 0) {
+            return false;
+        }
+
+        std::uint32_t file_version = 0;
+        std::uint32_t header_size = 0;
+        std::uint64_t capacity = 0;
+        std::uint64_t write_pos = 0;
+        if (!get(in, file_version) || file_version != MLogRing::version
+            || !get(in, header_size) || header_size < sizeof(MLogRing::Header)
+            || !get(in, capacity) || capacity == 0 || !get(in, write_pos)) {
+            return false;
+        }
+
+        std::string data(static_cast<std::size_t>(capacity), '\0');
+        in.seekg(header_size);
+        in.read(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!in) { return false; }
+
+        if (write_pos <= capacity) {
+            out.write(data.data(), static_cast<std::streamsize>(write_pos));
+            return true;
+        }
+
+        const auto offset = static_cast<std::size_t>(write_pos % capacity);
+        std::string text = data.substr(offset) + data.substr(0, offset);
+        const std::size_t begin = text.find('\n');
+        if (begin == std::string::npos) { return true; }
+
+        out.write(text.data() + begin + 1,
+                  static_cast<std::streamsize>(text.size() - begin - 1));
+        return true;
+    }
+
+private:
+    template <typename T>
+    static bool get(std::istream &in, T &value) {
+        in.read(reinterpret_cast<char *>(&value), sizeof(T));
+        return static_cast<bool>(in);
+    }
+};
+
+#endif  // MLOGRING_H_
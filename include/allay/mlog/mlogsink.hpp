@@ -0,0 +1,368 @@
+#ifndef MLOGSINK_H_
+#define MLOGSINK_H_
+
+#include "mlogtool.hpp"
+
+#include "mlogfilemanager.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+// 日志的附加输出目标
+// 一条记录只在调用线程中格式化一次，然后依次交给logger的所有sink，
+// 每个sink可以单独设置日志等级，只接收不低于这个等级的记录
+// 同一个sink可以被多个logger共享，write可能被同时调用，由sink自己加锁
+// 只有完整的记录(MLOG_XXX、mlog::info()、xxx_fmt)会交给sink，
+// 直接对logger使用<<的内容不会交给sink
+class MLogSink {
+public:
+    using Level = MLogTool::Level;
+
+    MLogSink() = default;
+    virtual ~MLogSink() = default;
+
+    MLogSink(const MLogSink &) = delete;
+    MLogSink &operator=(const MLogSink &) = delete;
+    MLogSink(MLogSink &&) = delete;
+    MLogSink &operator=(MLogSink &&) = delete;
+
+    // 默认不限制，只由全局等级和logger自己的等级决定
+    // 修改以后logger会重新计算所有sink的最低等级
+    MLogSink &set_level(Level level) {
+        m_level.store(level, std::memory_order_relaxed);
+        level_epoch().fetch_add(1, std::memory_order_release);
+        return (*this);
+    }
+
+    // 任意sink的等级每修改一次加1，logger据此判断缓存的最低等级是否过期
+    static std::atomic<std::uint64_t> &level_epoch() {
+        static std::atomic<std::uint64_t> the_epoch{0};
+        return the_epoch;
+    }
+
+    Level get_level() const { return m_level.load(std::memory_order_relaxed); }
+
+    bool should_log(Level level) const {
+        return m_level.load(std::memory_order_relaxed) <= level;
+    }
+
+    // record是一条完整的记录，包括日志开头和末尾的换行
+    // 在logger写出记录的线程中调用(异步模式下是后台线程)
+    virtual void write(Level level, std::string_view record) = 0;
+
+    virtual void flush() {}
+
+    // 是否接受带有ANSI颜色的记录
+    // 只有当logger的所有输出目标都接受时，记录中才会保留颜色
+    virtual bool accepts_color() const { return false; }
+
+private:
+    std::atomic<Level> m_level{Level::on};
+};
+
+// 输出到cout
+class MLogConsoleSink : public MLogSink {
+public:
+    void write(Level /*level*/, std::string_view record) override {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        std::cout.write(record.data(),
+                        static_cast<std::streamsize>(record.size()));
+    }
+
+    void flush() override {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        std::cout.flush();
+    }
+
+private:
+    std::mutex m_mtx;
+};
+
+// 带缓冲的控制台输出，适用于把标准输出重定向到文件或者管道的场景
+// 记录先追加到一大块缓冲区，超过buffer_bytes或者距离上次写出超过interval时，
+// 绕过std::cout用一次write系统调用写出，interval为0时只按照大小写出
+// 没有新记录时不会主动写出，剩余内容在flush或者析构时写出
+// 输出不是终端时去掉记录中的ANSI颜色
+class MLogBufferedConsoleSink : public MLogSink {
+public:
+#ifdef _WIN32
+    constexpr static int stdout_fd = 1;
+#else
+    constexpr static int stdout_fd = STDOUT_FILENO;
+#endif
+
+    explicit MLogBufferedConsoleSink(
+        std::size_t buffer_bytes = 64 * 1024,
+        std::chrono::milliseconds interval = std::chrono::milliseconds{100},
+        int fd = stdout_fd)
+        : m_buffer_bytes(buffer_bytes), m_interval(interval), m_fd(fd),
+          m_strip_color(!is_terminal(fd)),
+          m_last_write(std::chrono::steady_clock::now()) {
+        m_buffer.reserve(m_buffer_bytes);
+    }
+
+    ~MLogBufferedConsoleSink() override { write_out(); }
+
+    MLogBufferedConsoleSink(const MLogBufferedConsoleSink &) = delete;
+    MLogBufferedConsoleSink &operator=(const MLogBufferedConsoleSink &) =
+        delete;
+    MLogBufferedConsoleSink(MLogBufferedConsoleSink &&) = delete;
+    MLogBufferedConsoleSink &operator=(MLogBufferedConsoleSink &&) = delete;
+
+    void write(Level /*level*/, std::string_view record) override {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        if (m_strip_color) { append_without_color(m_buffer, record); }
+        else { m_buffer += record; }
+
+        if (m_buffer.size() >= m_buffer_bytes
+            || (m_interval.count() > 0
+                && std::chrono::steady_clock::now() - m_last_write
+                       >= m_interval)) {
+            write_out();
+        }
+    }
+
+    void flush() override {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        write_out();
+    }
+
+    bool accepts_color() const override { return true; }
+
+    // 已经执行的write系统调用次数
+    std::uint64_t get_write_count() const {
+        return m_write_count.load(std::memory_order_relaxed);
+    }
+
+    // 去掉ANSI转义序列，即ESC [ 参数 结尾字符(0x40到0x7e)
+    static void append_without_color(std::string &buffer,
+                                     std::string_view text) {
+        std::size_t pos = 0;
+        while (pos < text.size()) {
+            const std::size_t esc = text.find('\x1b', pos);
+            if (esc == std::string_view::npos) { break; }
+            buffer.append(text.substr(pos, esc - pos));
+
+            pos = esc + 1;
+            if (pos < text.size() && text[pos] == '[') {
+                ++pos;
+                while (pos < text.size()
+                       && (text[pos] < 0x40 || text[pos] > 0x7e)) {
+                    ++pos;
+                }
+                ++pos;  // 结尾字符
+            }
+        }
+        if (pos < text.size()) { buffer.append(text.substr(pos)); }
+    }
+
+private:
+    static bool is_terminal(int fd) {
+#ifdef _WIN32
+        return _isatty(fd) != 0;
+#else
+        return ::isatty(fd) != 0;
+#endif
+    }
+
+    // 调用方需要持有m_mtx
+    // 先写出std::cout中可能残留的内容，保证与直接使用cout的输出顺序一致
+    void write_out() {
+        m_last_write = std::chrono::steady_clock::now();
+        if (m_buffer.empty()) { return; }
+
+        std::cout.flush();
+        const char *data = m_buffer.data();
+        std::size_t left = m_buffer.size();
+        while (left > 0) {
+#ifdef _WIN32
+            const int written =
+                _write(m_fd, data, static_cast<unsigned int>(left));
+#else
+            const ::ssize_t written = ::write(m_fd, data, left);
+            if (written < 0 && errno == EINTR) { continue; }
+#endif
+            if (written <= 0) { break; }  // 输出已经关闭时直接丢弃
+            data += written;
+            left -= static_cast<std::size_t>(written);
+        }
+        m_write_count.fetch_add(1, std::memory_order_relaxed);
+        m_buffer.clear();
+    }
+
+    const std::size_t m_buffer_bytes;
+    const std::chrono::milliseconds m_interval;
+    const int m_fd;
+    const bool m_strip_color;
+    std::string m_buffer;
+    std::chrono::steady_clock::time_point m_last_write;
+    std::atomic<std::uint64_t> m_write_count{0};
+    std::mutex m_mtx;
+};
+
+// 输出到日志文件，文件名同样由MLogFileManager占用，不能与其它logger或sink重复
+// 可以指定轮转策略，轮转只在记录之间进行，每条记录完整地写入某一个文件
+class MLogFileSink : public MLogSink {
+public:
+    using Rotation = MLogFileManager::RotationPolicy;
+
+    // 打开失败时报错退出
+    explicit MLogFileSink(const std::string &file_name,
+                          const Rotation &rotation = Rotation{},
+                          std::ios_base::openmode mode = std::ios_base::app)
+        : m_file_name(file_name),
+          m_full_file_name(MLogFileManager::get_path_prefix() + file_name),
+          m_mode(std::ios_base::out | mode), m_rotation(rotation) {
+        m_ofstream = MLogFileManager::get_unique_ofstream(m_file_name);
+        if (!m_ofstream) { notice_open_file_failed_and_exit(); }
+
+        open_file(m_mode);
+        m_file_bytes = (m_mode & std::ios_base::app)
+                           ? MLogFileManager::file_size(m_full_file_name)
+                           : 0;
+    }
+
+    ~MLogFileSink() override {
+        m_ofstream->close();
+        MLogFileManager::erase_unique_ofstream(m_file_name);
+    }
+
+    MLogFileSink(const MLogFileSink &) = delete;
+    MLogFileSink &operator=(const MLogFileSink &) = delete;
+    MLogFileSink(MLogFileSink &&) = delete;
+    MLogFileSink &operator=(MLogFileSink &&) = delete;
+
+    void write(Level /*level*/, std::string_view record) override {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        if (m_rotation.enabled() && m_file_bytes > 0
+            && ((m_rotation.max_bytes > 0
+                 && m_file_bytes + record.size() > m_rotation.max_bytes)
+                || (m_rotation.max_age.count() > 0
+                    && std::chrono::steady_clock::now() - m_file_open_time
+                           >= m_rotation.max_age))) {
+            rotate_file();
+        }
+
+        m_ofstream->write(record.data(),
+                          static_cast<std::streamsize>(record.size()));
+        m_file_bytes += record.size();
+    }
+
+    void flush() override {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_ofstream->flush();
+    }
+
+    const std::string &get_file_name() const { return m_file_name; }
+
+private:
+    void open_file(std::ios_base::openmode mode) {
+        m_ofstream->open(m_full_file_name, mode);
+        if (m_ofstream->fail()) {
+            MLogFileManager::erase_unique_ofstream(m_file_name);
+            notice_open_file_failed_and_exit();
+        }
+        m_file_open_time = std::chrono::steady_clock::now();
+    }
+
+    // 改名失败时追加到原来的文件，不能截断已经写出的记录
+    void rotate_file() {
+        m_ofstream->close();
+        const bool rotated = MLogFileManager::rotate_files(
+            m_full_file_name, m_rotation.max_files);
+        if (!rotated) {
+            std::cerr << "MLog: Can not rotate file \"" << m_full_file_name
+                      << "\".\n";
+        }
+
+        open_file(rotated ? m_mode
+                          : ((m_mode & ~std::ios_base::trunc)
+                             | std::ios_base::app));
+        m_file_bytes = 0;
+    }
+
+    void notice_open_file_failed_and_exit() const {
+        std::cerr << "MLog: Can not open file \"" << m_full_file_name
+                  << "\".\n";
+        MLogTool::raise_error();
+    }
+
+    const std::string m_file_name;       // 不含前缀的文件名
+    const std::string m_full_file_name;  // 含前缀的文件名
+    const std::ios_base::openmode m_mode;
+    const Rotation m_rotation;
+    std::shared_ptr<std::ofstream> m_ofstream;
+    std::uintmax_t m_file_bytes{0};  // 当前文件已经写入的字节数
+    std::chrono::steady_clock::time_point m_file_open_time;
+    std::mutex m_mtx;
+};
+
+// 在内存中保留最近的max_records条记录，例如用于测试或者在界面中展示
+class MLogMemorySink : public MLogSink {
+public:
+    explicit MLogMemorySink(std::size_t max_records = 1024)
+        : m_max_records(max_records) {}
+
+    void write(Level /*level*/, std::string_view record) override {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        if (m_max_records == 0) { return; }
+        if (m_records.size() == m_max_records) { m_records.pop_front(); }
+        m_records.emplace_back(record);
+    }
+
+    // 按照写入顺序返回当前保留的记录
+    std::vector<std::string> get_records() const {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        return {m_records.begin(), m_records.end()};
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_records.clear();
+    }
+
+private:
+    const std::size_t m_max_records;
+    std::deque<std::string> m_records;
+    mutable std::mutex m_mtx;
+};
+
+// 把每条记录交给用户的回调函数
+// 回调在持有logger的记录锁时调用，不能再向同一个logger写日志
+class MLogCallbackSink : public MLogSink {
+public:
+    using Callback = std::function<void(Level, std::string_view)>;
+
+    explicit MLogCallbackSink(Callback callback)
+        : m_callback(std::move(callback)) {}
+
+    void write(Level level, std::string_view record) override {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_callback(level, record);
+    }
+
+private:
+    Callback m_callback;
+    std::mutex m_mtx;
+};
+
+#endif  // MLOGSINK_H_
@@ -2,11 +2,19 @@
 #define MLOGTOOL_H_
 
 
+#include <algorithm>
+#include <atomic>
+#include <charconv>
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
 #include <iostream>
 #include <mutex>  // IWYU pragma: keep
-#include <regex>
+#include <source_location>
+#include <streambuf>
 #include <string>
+#include <string_view>
 
 class MLogTool {
 public:
@@ -44,98 +52,305 @@ public:
         YELLOW,
     };
 
+    // 异步模式下队列已满时的处理方式
+    enum class OverflowPolicy {
+        BLOCK = 0,    // 等待后台线程腾出空间
+        DROP_NEWEST,  // 丢弃当前这条记录
+        DROP_OLDEST,  // 丢弃队列中最早的一条记录
+    };
+
+    // 直接追加到std::string的streambuf
+    // 用于把任意类型通过operator<<格式化到一个可复用的缓冲区
+    class StringBuf : public std::streambuf {
+    public:
+        explicit StringBuf(std::string &str) : m_str(&str) {}
+
+    protected:
+        int_type overflow(int_type ch) override {
+            if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+                m_str->push_back(traits_type::to_char_type(ch));
+            }
+            return traits_type::not_eof(ch);
+        }
+
+        std::streamsize xsputn(const char *s, std::streamsize n) override {
+            m_str->append(s, static_cast<std::size_t>(n));
+            return n;
+        }
+
+    private:
+        std::string *m_str;
+    };
+
+    // 以下几个计数器用于MLOG_IF_XXX宏，通常是函数内的静态变量，会被多个线程同时调用
+    // 计数器都是relaxed原子变量，只需要保证计数本身准确，不需要与其它内存同步
+
+    // 只有前n次返回true，超过以后只需要一次原子读取
     class FirstN {
     private:
         const std::size_t m_first_n;
-        std::size_t m_first_count_n{0};
+        std::atomic<std::size_t> m_first_count_n{0};
 
     public:
         explicit FirstN(std::size_t first_n) : m_first_n(first_n) {}
 
         bool judge() {
-            if (m_first_count_n < m_first_n) {
-                ++m_first_count_n;
-                return true;
+            if (m_first_count_n.load(std::memory_order_relaxed) >= m_first_n) {
+                return false;
             }
-            return false;
+            return m_first_count_n.fetch_add(1, std::memory_order_relaxed)
+                   < m_first_n;
         }
 
-        std::size_t get_count() const { return m_first_count_n; }
+        // 超过n以后不再计数，最多比n多出同时调用的线程数
+        std::size_t get_count() const {
+            return m_first_count_n.load(std::memory_order_relaxed);
+        }
     };
 
+    // 第1次、第n+1次、第2n+1次……返回true
     class EveryN {
     private:
         const std::size_t m_every_n;
-        std::size_t m_every_count_n{0};
+        std::atomic<std::size_t> m_every_count_n{0};
 
     public:
-        explicit EveryN(std::size_t every_n) : m_every_n(every_n) {}
+        explicit EveryN(std::size_t every_n)
+            : m_every_n(every_n == 0 ? 1 : every_n) {}
 
-        bool judge() { return ((m_every_count_n++) % m_every_n) == 0; }
+        bool judge() {
+            return (m_every_count_n.fetch_add(1, std::memory_order_relaxed)
+                    % m_every_n)
+                   == 0;
+        }
 
-        std::size_t get_count() const { return m_every_count_n; }
+        std::size_t get_count() const {
+            return m_every_count_n.load(std::memory_order_relaxed);
+        }
     };
 
+    // 前n次返回false，之后返回true，超过以后只需要一次原子读取
     class MoreThanN {
     private:
         const std::size_t m_morethan_n;
-        std::size_t m_morethan_count_n{0};
+        std::atomic<std::size_t> m_morethan_count_n{0};
 
     public:
         explicit MoreThanN(std::size_t morethan_n) : m_morethan_n(morethan_n) {}
 
-        bool judge() { return (m_morethan_count_n++ >= m_morethan_n); }
+        bool judge() {
+            if (m_morethan_count_n.load(std::memory_order_relaxed)
+                >= m_morethan_n) {
+                return true;
+            }
+            return m_morethan_count_n.fetch_add(1, std::memory_order_relaxed)
+                   >= m_morethan_n;
+        }
+
+        // 超过n以后不再计数
+        std::size_t get_count() const {
+            return m_morethan_count_n.load(std::memory_order_relaxed);
+        }
+    };
+
+    // 每隔ms毫秒最多返回一次true
+    // 未到时间时只需要读取时钟和一次原子读取，到时间后由CAS成功的线程返回true
+    class EveryMs {
+    private:
+        const std::int64_t m_interval;  // steady_clock的计数
+        std::atomic<std::int64_t> m_next{0};
+        std::atomic<std::size_t> m_pass_count{0};
+
+    public:
+        explicit EveryMs(std::int64_t ms)
+            : m_interval(std::chrono::duration_cast<
+                             std::chrono::steady_clock::duration>(
+                             std::chrono::milliseconds(ms))
+                             .count()) {}
+
+        bool judge() {
+            return judge(
+                std::chrono::steady_clock::now().time_since_epoch().count());
+        }
+
+        // 使用调用方给出的时间(steady_clock的计数)，便于测试
+        bool judge(std::int64_t now) {
+            std::int64_t next = m_next.load(std::memory_order_relaxed);
+            if (now < next) { return false; }
+            if (!m_next.compare_exchange_strong(next, now + m_interval,
+                                                std::memory_order_relaxed)) {
+                return false;
+            }
+            m_pass_count.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        // 返回true的次数
+        std::size_t get_count() const {
+            return m_pass_count.load(std::memory_order_relaxed);
+        }
+    };
+
+    // 令牌桶限流，平均每秒最多per_sec次返回true，允许突发per_sec次
+    // 使用GCRA算法，整个令牌桶只是一个原子变量(理论上的下一次到达时间)，
+    // 令牌不足时只需要读取时钟和一次原子读取
+    class RateLimit {
+    private:
+        const std::int64_t m_interval;   // 每个令牌对应的steady_clock计数
+        const std::int64_t m_tolerance;  // 允许的突发量
+        std::atomic<std::int64_t> m_tat{0};
+        std::atomic<std::size_t> m_pass_count{0};
+
+    public:
+        explicit RateLimit(std::size_t per_sec)
+            : m_interval(std::chrono::duration_cast<
+                             std::chrono::steady_clock::duration>(
+                             std::chrono::seconds(1))
+                             .count()
+                         / static_cast<std::int64_t>(per_sec == 0 ? 1 : per_sec)),
+              m_tolerance(m_interval
+                          * (static_cast<std::int64_t>(per_sec == 0 ? 1 : per_sec)
+                             - 1)) {}
+
+        bool judge() {
+            return judge(
+                std::chrono::steady_clock::now().time_since_epoch().count());
+        }
+
+        // 使用调用方给出的时间(steady_clock的计数)，便于测试
+        bool judge(std::int64_t now) {
+            std::int64_t tat = m_tat.load(std::memory_order_relaxed);
+            while (true) {
+                if (now < tat - m_tolerance) { return false; }
+
+                const std::int64_t new_tat = std::max(tat, now) + m_interval;
+                if (m_tat.compare_exchange_weak(tat, new_tat,
+                                                std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            m_pass_count.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        // 返回true的次数
+        std::size_t get_count() const {
+            return m_pass_count.load(std::memory_order_relaxed);
+        }
+    };
+
+    // 源代码位置，只在真正输出时才格式化
+    // 格式例如[main.cpp main 12]，末尾带换行
+    // 函数名由宏传入__FUNCTION__，只有名称，不是function_name()的完整签名
+    class SourceStamp {
+    public:
+        SourceStamp(const std::source_location &location, const char *function)
+            : m_location(location), m_function(function) {}
+
+        void append_to(std::string &buffer) const {
+            char line[16]{};
+            auto result =
+                std::to_chars(static_cast<char *>(line),
+                              static_cast<char *>(line) + sizeof(line),
+                              m_location.line());
+
+            buffer += '[';
+            buffer += m_location.file_name();
+            buffer += ' ';
+            buffer += m_function;
+            buffer += ' ';
+            buffer.append(static_cast<char *>(line), result.ptr);
+            buffer += "]\n";
+        }
+
+        std::string str() const {
+            std::string result;
+            append_to(result);
+            return result;
+        }
+
+        friend std::ostream &operator<<(std::ostream &os,
+                                        const SourceStamp &stamp) {
+            return os << stamp.str();
+        }
 
-        std::size_t get_count() const { return m_morethan_count_n; }
+    private:
+        std::source_location m_location;
+        const char *m_function;
     };
 
     static void set_level(MLogTool::Level level) {
 #ifndef MLOG_USE_MACRO_LEVEL
-        get_level_instance() = level;
+        get_level_instance().store(level, std::memory_order_relaxed);
 #endif
     }
 
-    static MLogTool::Level &get_level_instance() {
+    // 全局日志等级，可能在其它线程写日志时被修改，所以是原子变量
+    static std::atomic<MLogTool::Level> &get_level_instance() {
 #ifndef MLOG_USE_MACRO_LEVEL
-        static MLogTool::Level the_global_level{MLogTool::Level::on};
+        static std::atomic<MLogTool::Level> the_global_level{
+            MLogTool::Level::on};
 #else
-        static MLogTool::Level the_global_level = MLOG_LEVEL;
+        static std::atomic<MLogTool::Level> the_global_level{MLOG_LEVEL};
 #endif
         return the_global_level;
     }
 
+    // 判断指定等级的日志是否需要输出
+    // 如果定义了MLOG_LEVEL，结果是编译期常量，不满足等级的语句会被编译器直接删除
+    static bool is_level_enabled(MLogTool::Level level) {
+#ifndef MLOG_USE_MACRO_LEVEL
+        return get_level_instance().load(std::memory_order_relaxed) <= level;
+#else
+        return MLOG_LEVEL <= level;
+#endif
+    }
+
     // 时间戳
-    // 格式例如[2016-06-21 20:54:11:123]
+    // 格式例如[2016-06-21 20:54:11.123]
     static std::string time_stamp() {
-        auto now = std::chrono::system_clock::now();
-        auto now_time_t = std::chrono::system_clock::to_time_t(now);
-        auto now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-                          now.time_since_epoch())
-                      % 1000;
-
-        char buffer[32]{};
+        std::string result;
+        append_time_stamp(result);
+        return result;
+    }
 
-        struct tm timeinfo{};
+    // 把时间戳直接追加到buffer中，格式同time_stamp
+    static void append_time_stamp(std::string &buffer) {
+        append_time_stamp(buffer, std::chrono::system_clock::now());
+    }
 
-#if defined(_MSC_VER)
-        localtime_s(&timeinfo, &now_time_t);
-#elif defined(__unix__)
-        localtime_r(&now_time_t, &timeinfo);
-#else
-        static std::mutex mtx;
-        {
-            std::lock_guard<std::mutex> lock(mtx);
-            timeinfo = *localtime(&now_time_t);
+    // 把指定时刻的时间戳追加到buffer中
+    // 每个线程缓存精确到秒的部分，同一秒内只需要重新生成毫秒部分
+    static void append_time_stamp(std::string &buffer,
+                                  std::chrono::system_clock::time_point time) {
+        struct Cache {
+            std::int64_t seconds{-1};
+            char text[32]{};
+            std::size_t size{0};
+        };
+        thread_local Cache cache;
+
+        const auto now_ms = std::chrono::floor<std::chrono::milliseconds>(time)
+                                .time_since_epoch()
+                                .count();
+        const std::int64_t seconds =
+            (now_ms >= 0) ? now_ms / 1000 : ((now_ms - 999) / 1000);
+        const auto ms = static_cast<int>(now_ms - (seconds * 1000));
+
+        if (seconds != cache.seconds) {
+            struct tm timeinfo = local_time(static_cast<std::time_t>(seconds));
+            cache.size = std::strftime(static_cast<char *>(cache.text),
+                                       sizeof(cache.text), "[%Y-%m-%d %H:%M:%S",
+                                       &timeinfo);
+            cache.seconds = seconds;
         }
-#endif
-
-        std::strftime(static_cast<char *>(buffer), sizeof(buffer),
-                      "[%Y-%m-%d %H:%M:%S", &timeinfo);
 
-        std::snprintf(static_cast<char *>(buffer) + 20, 7, ".%03d]",
-                      static_cast<int>(now_ms.count()));
+        const char suffix[5]{'.', static_cast<char>('0' + ms / 100),
+                             static_cast<char>('0' + ms / 10 % 10),
+                             static_cast<char>('0' + ms % 10), ']'};
 
-        return std::string{static_cast<char *>(buffer)};
+        buffer.append(static_cast<const char *>(cache.text), cache.size);
+        buffer.append(static_cast<const char *>(suffix), sizeof(suffix));
     }
 
     // 等级输出
@@ -158,6 +373,58 @@ public:
         }
     }
 
+    // 等级对应的颜色，没有颜色时返回nullptr
+    static const char *level_color(Level level) {
+        switch (level) {
+        case Level::debug: return ansi_color_blue;
+        case Level::info: return ansi_color_green;
+        case Level::warn: return ansi_color_yellow;
+        case Level::error: return ansi_color_red;
+        case Level::on:
+        case Level::off:
+        default: return nullptr;
+        }
+    }
+
+    // 按照指定格式把日志开头追加到buffer中，例如[INFO]{A}[2016-06-21 20:54:11.123]
+    // 只有需要时间戳时才调用get_time获取时刻，with_color决定LEVEL_COLOR是否带颜色
+    template <typename TimeFunc>
+    static void append_log_start(std::string &buffer, Level level,
+                                 LogStartFormat log_start_format,
+                                 std::string_view signature,
+                                 TimeFunc &&get_time, bool with_color) {
+        switch (log_start_format) {
+        case LogStartFormat::LEVEL_SIGNATURE_TIME:
+            buffer += level_stamp(level);
+            buffer += signature;
+            append_time_stamp(buffer, get_time());
+            return;
+        case LogStartFormat::LEVEL_SIGNATURE:
+            buffer += level_stamp(level);
+            buffer += signature;
+            return;
+        case LogStartFormat::LEVEL_TIME:
+            buffer += level_stamp(level);
+            append_time_stamp(buffer, get_time());
+            return;
+        case LogStartFormat::LEVEL: buffer += level_stamp(level); return;
+        case LogStartFormat::LEVEL_COLOR: {
+            const char *color_prefix = level_color(level);
+            if (color_prefix != nullptr && with_color) {
+                buffer += color_prefix;
+                buffer += level_stamp(level);
+                buffer += ansi_color_end;
+            }
+            else {
+                buffer += level_stamp(level);
+            }
+            return;
+        }
+        case LogStartFormat::NONE:
+        default: return;
+        }
+    }
+
     // 时间字符串 可用于日志文件名
     // 例如01-25-21-33
     static std::string date_string() {
@@ -166,19 +433,7 @@ public:
 
         char buffer[32]{};
 
-        struct tm timeinfo{};
-
-#if defined(_MSC_VER)
-        localtime_s(&timeinfo, &now_time_t);
-#elif defined(__unix__)
-        localtime_r(&now_time_t, &timeinfo);
-#else
-        static std::mutex mtx;
-        {
-            std::lock_guard<std::mutex> lock(mtx);
-            timeinfo = *localtime(&now_time_t);
-        }
-#endif
+        struct tm timeinfo = local_time(now_time_t);
 
         std::strftime(static_cast<char *>(buffer), sizeof(buffer),
                       "%m-%d-%H-%M-%S", &timeinfo);
@@ -187,18 +442,52 @@ public:
     }
 
     // 判断文件名合法
-    // Windows下文件名中不能包含\/:*?"<>|这些字符
+    // Windows下文件名中不能包含/:*?"<>|这些字符
     // 并且文件名长度这里不允许超过100
-    static bool check_filename_valid(const std::string &file_name) {
-        std::regex reg_express("[\\/:*?\"<>|]");
-        return (!std::regex_search(file_name, reg_express)
-                && (file_name.size() <= 100));
+    // 只做一次线性扫描，不分配内存，对字面量名称也可以在编译期检查
+    static constexpr bool check_filename_valid(std::string_view file_name) {
+        if (file_name.size() > 100) { return false; }
+
+        for (const char ch : file_name) {
+            switch (ch) {
+            case '/':
+            case ':':
+            case '*':
+            case '?':
+            case '"':
+            case '<':
+            case '>':
+            case '|': return false;
+            default: break;
+            }
+        }
+        return true;
     }
 
     static void raise_error() {
         std::cerr << "MLog: The program can not perform as expected!";
         exit(1);
     }
+
+private:
+    // 线程安全地转换为本地时间
+    static struct tm local_time(std::time_t time) {
+        struct tm timeinfo{};
+
+#if defined(_MSC_VER)
+        localtime_s(&timeinfo, &time);
+#elif defined(__unix__)
+        localtime_r(&time, &timeinfo);
+#else
+        static std::mutex mtx;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            timeinfo = *localtime(&time);
+        }
+#endif
+
+        return timeinfo;
+    }
 };
 
 #endif  // MLOGTOOL_H_
@@ -5,10 +5,10 @@
 #include <iomanip>
 #include <iostream>
 #include <optional>
-#include <regex>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
@@ -265,6 +265,22 @@ public:
     // 获取多余参数（保持原有顺序）
     const std::vector<std::string> &get_rest() const { return m_rest; }
 
+    // 零到两个横线 `-` 开头，后接 1 到 8 个大小写字母、数字或下划线，
+    // 即总长度不超过 10，与 ^-{0,2}[A-Za-z0-9_]{1,8}$ 等价。
+    // 只做一次线性扫描，不分配内存，也可以在编译期使用。
+    static constexpr bool is_valid_name(std::string_view name) {
+        std::size_t dash = 0;
+        while (dash < 2 && dash < name.size() && name[dash] == '-') { ++dash; }
+
+        const std::string_view body = name.substr(dash);
+        if (body.empty() || body.size() > 8) { return false; }
+
+        return std::ranges::all_of(body, [](char ch) {
+            return (ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z')
+                   || (ch >= '0' && ch <= '9') || ch == '_';
+        });
+    }
+
 private:
     struct OptionInfo {
         std::function<bool(const std::string &)> setter;
@@ -302,10 +318,7 @@ private:
     }
 
     static void check_valid_name(const std::string &name) noexcept {
-        // 正则表达式：零到两个横线 `-`
-        // 开头，后接大小写字母、数字或下划线，且总长度不超过 10。
-        const std::regex pattern(R"(^-{0,2}[A-Za-z0-9_]{1,8}$)");
-        if (!std::regex_match(name, pattern)) {
+        if (!is_valid_name(name)) {
             std::cerr << "MParser error: Invalid name: " << name;
             exit(1);
         }
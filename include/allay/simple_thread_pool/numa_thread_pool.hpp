@@ -0,0 +1,222 @@
+#pragma once
+
+#include "simple_thread_pool.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// 机器的NUMA拓扑: 每个节点包含哪些CPU
+// 在Linux上从/sys/devices/system/node读取，并且只保留当前进程允许使用的CPU
+// 读取失败(非Linux、容器中没有/sys等)时视为只有一个节点，包含所有CPU
+class CpuTopology {
+public:
+    struct Node {
+        std::uint32_t id{0};              // 系统中的节点编号
+        std::vector<std::uint32_t> cpus;  // 升序
+    };
+
+    static CpuTopology detect() {
+        CpuTopology topology;
+        const std::vector<std::uint32_t> allowed = allowed_cpus();
+
+        const std::string root = "/sys/devices/system/node/";
+        for (std::uint32_t id : parse_cpu_list(read_line(root + "online"))) {
+            Node node{id, {}};
+            const std::string path =
+                root + "node" + std::to_string(id) + "/cpulist";
+            for (std::uint32_t cpu : parse_cpu_list(read_line(path))) {
+                if (std::binary_search(allowed.begin(), allowed.end(), cpu)) {
+                    node.cpus.push_back(cpu);
+                }
+            }
+            // 没有CPU的节点(只有内存)或者进程不能使用的节点跳过
+            if (!node.cpus.empty()) {
+                topology.m_nodes.push_back(std::move(node));
+            }
+        }
+
+        if (topology.m_nodes.empty()) {
+            topology.m_nodes.push_back(Node{0, allowed});
+        }
+        return topology;
+    }
+
+    // 解析"0-3,8,10-11"形式的列表，格式错误时返回空
+    static std::vector<std::uint32_t> parse_cpu_list(const std::string &text) {
+        std::vector<std::uint32_t> cpus;
+        std::size_t pos = 0;
+        while (pos < text.size()) {
+            std::size_t end = text.find(',', pos);
+            if (end == std::string::npos) { end = text.size(); }
+
+            const std::string item = text.substr(pos, end - pos);
+            const std::size_t dash = item.find('-');
+            std::uint32_t first = 0;
+            std::uint32_t last = 0;
+            if (!parse_number(item.substr(0, dash), first)) { return {}; }
+            if (dash == std::string::npos) { last = first; }
+            else if (!parse_number(item.substr(dash + 1), last)
+                     || last < first) {
+                return {};
+            }
+
+            for (std::uint32_t cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+            pos = end + 1;
+        }
+
+        std::sort(cpus.begin(), cpus.end());
+        cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+        return cpus;
+    }
+
+    const std::vector<Node> &get_nodes() const { return m_nodes; }
+
+    std::size_t get_node_num() const { return m_nodes.size(); }
+
+    // CPU所属节点在get_nodes()中的下标，未知的CPU返回0
+    std::size_t node_of_cpu(std::uint32_t cpu) const {
+        for (std::size_t i = 0; i < m_nodes.size(); ++i) {
+            const auto &cpus = m_nodes[i].cpus;
+            if (std::binary_search(cpus.begin(), cpus.end(), cpu)) {
+                return i;
+            }
+        }
+        return 0;
+    }
+
+    // 调用线程当前所在节点的下标，无法获取时返回0
+    std::size_t current_node() const {
+#if defined(__linux__)
+        const int cpu = sched_getcpu();
+        if (cpu >= 0) { return node_of_cpu(static_cast<std::uint32_t>(cpu)); }
+#endif
+        return 0;
+    }
+
+private:
+    static std::string read_line(const std::string &path) {
+        std::ifstream file(path);
+        std::string line;
+        std::getline(file, line);
+        return line;
+    }
+
+    static bool parse_number(const std::string &text, std::uint32_t &value) {
+        if (text.empty() || text.size() > 9) { return false; }
+        value = 0;
+        for (char c : text) {
+            if (c < '0' || c > '9') { return false; }
+            value = value * 10 + static_cast<std::uint32_t>(c - '0');
+        }
+        return true;
+    }
+
+    // 进程允许使用的CPU，升序
+    static std::vector<std::uint32_t> allowed_cpus() {
+        std::vector<std::uint32_t> cpus;
+#if defined(__linux__)
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0) {
+            for (std::uint32_t cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &cpu_set)) { cpus.push_back(cpu); }
+            }
+        }
+#endif
+        if (cpus.empty()) {
+            const std::uint32_t cpu_num =
+                std::max(std::thread::hardware_concurrency(), 1U);
+            for (std::uint32_t cpu = 0; cpu < cpu_num; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        }
+        return cpus;
+    }
+
+    std::vector<Node> m_nodes;
+};
+
+// 按NUMA节点划分的线程池
+// 每个节点一个SimpleThreadPool，线程绑定到这个节点的CPU上，任务队列也在节点内，
+// 任务和它访问的数据(由同一节点的线程首次写入)留在同一个节点，
+// 避免线程在插槽之间迁移以及跨节点访问内存
+// 不支持绑定的平台上仍然可以使用，只是不再保证线程所在的节点
+class NumaThreadPool {
+public:
+    using Mode = SimpleThreadPool::Mode;
+
+    // threads_per_node为0时每个节点的线程数等于这个节点的CPU数
+    explicit NumaThreadPool(std::uint32_t threads_per_node = 0,
+                            Mode mode = Mode::SHARED_QUEUE)
+        : NumaThreadPool(CpuTopology::detect(), threads_per_node, mode) {}
+
+    NumaThreadPool(CpuTopology topology, std::uint32_t threads_per_node,
+                   Mode mode)
+        : m_topology(std::move(topology)) {
+        for (const auto &node : m_topology.get_nodes()) {
+            const auto thread_num =
+                (threads_per_node > 0)
+                    ? threads_per_node
+                    : static_cast<std::uint32_t>(node.cpus.size());
+            m_pools.push_back(std::make_unique<SimpleThreadPool>(thread_num,
+                                                                 mode));
+            m_pinned = m_pools.back()->set_affinity({node.cpus}) && m_pinned;
+        }
+    }
+
+    NumaThreadPool(const NumaThreadPool &) = delete;
+    NumaThreadPool &operator=(const NumaThreadPool &) = delete;
+
+    // 提交到调用线程所在的节点
+    template <class F, class... Args>
+    auto commit(F &&f, Args &&...args) {
+        return commit_on(m_topology.current_node(), std::forward<F>(f),
+                         std::forward<Args>(args)...);
+    }
+
+    // 提交到指定的节点，node为get_topology().get_nodes()中的下标，
+    // 超出范围时取模
+    template <class F, class... Args>
+    auto commit_on(std::size_t node, F &&f, Args &&...args) {
+        return get_node_pool(node).commit(std::forward<F>(f),
+                                          std::forward<Args>(args)...);
+    }
+
+    template <class F, class... Args>
+    void post(F &&f, Args &&...args) {
+        post_on(m_topology.current_node(), std::forward<F>(f),
+                std::forward<Args>(args)...);
+    }
+
+    template <class F, class... Args>
+    void post_on(std::size_t node, F &&f, Args &&...args) {
+        get_node_pool(node).post(std::forward<F>(f),
+                                 std::forward<Args>(args)...);
+    }
+
+    // 某个节点的线程池，可以使用优先级、批量提交等完整的接口
+    SimpleThreadPool &get_node_pool(std::size_t node) {
+        return *m_pools[node % m_pools.size()];
+    }
+
+    const CpuTopology &get_topology() const { return m_topology; }
+
+    std::size_t get_node_num() const { return m_pools.size(); }
+
+    // 所有线程是否都已经绑定到所在节点的CPU上
+    bool is_pinned() const { return m_pinned; }
+
+private:
+    CpuTopology m_topology;
+    std::vector<std::unique_ptr<SimpleThreadPool>> m_pools;
+    bool m_pinned{true};
+};
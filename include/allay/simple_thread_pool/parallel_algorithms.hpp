@@ -0,0 +1,237 @@
+#pragma once
+
+#include "simple_thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// 基于SimpleThreadPool的并行算法
+// 区间按照线程数切分为若干块，一次调用只向线程池提交O(线程数)个任务
+// 调用线程同样参与领取和执行，因此可以在线程池的任务内部嵌套调用
+// grain为每一块的最小元素数，为0时自动选择
+// 任意一块抛出异常时，尚未开始的块被跳过，所有块结束后在调用线程重新抛出
+
+namespace simple_thread_pool_detail {
+
+// 一次并行调用的共享状态
+// 任务可能在调用返回以后才开始执行，此时只会访问计数器，不会再调用chunk_func
+struct ChunkState {
+    explicit ChunkState(std::size_t num)
+        : next_chunk(0), remaining(num), chunk_num(num) {}
+
+    // 不断领取下一块并执行，直到所有块都被领取
+    template <typename ChunkFunc>
+    void run(ChunkFunc &chunk_func) {
+        for (;;) {
+            const std::size_t chunk =
+                next_chunk.fetch_add(1, std::memory_order_relaxed);
+            if (chunk >= chunk_num) { return; }
+
+            if (!failed.load(std::memory_order_relaxed)) {
+                try {
+                    chunk_func(chunk);
+                }
+                catch (...) {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    if (!error) { error = std::current_exception(); }
+                    failed.store(true, std::memory_order_relaxed);
+                }
+            }
+
+            if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                remaining.notify_all();
+            }
+        }
+    }
+
+    void wait() {
+        std::size_t left = remaining.load(std::memory_order_acquire);
+        while (left != 0) {
+            remaining.wait(left, std::memory_order_acquire);
+            left = remaining.load(std::memory_order_acquire);
+        }
+    }
+
+    std::atomic<std::size_t> next_chunk;
+    std::atomic<std::size_t> remaining;
+    const std::size_t chunk_num;
+    std::atomic_bool failed{false};
+    std::mutex mtx;
+    std::exception_ptr error;
+};
+
+// 把n个元素切分为块的数目
+// 每个线程最多分到4块，使得耗时不均匀时仍然可以负载均衡
+inline std::size_t chunk_count(const SimpleThreadPool &pool, std::size_t n,
+                               std::size_t grain) {
+    if (n == 0) { return 0; }
+
+    const std::size_t max_chunk_num =
+        (static_cast<std::size_t>(pool.get_thread_num()) + 1) * 4;
+    if (grain == 0) { return std::min(n, max_chunk_num); }
+    return std::clamp<std::size_t>(n / grain, 1, max_chunk_num);
+}
+
+// 第chunk块对应的区间[begin, end)
+inline std::pair<std::size_t, std::size_t>
+chunk_range(std::size_t n, std::size_t chunk_num, std::size_t chunk) {
+    return {n * chunk / chunk_num, n * (chunk + 1) / chunk_num};
+}
+
+// 在线程池和调用线程上执行chunk_func(0) ... chunk_func(chunk_num - 1)
+template <typename ChunkFunc>
+void run_chunks(SimpleThreadPool &pool, std::size_t chunk_num,
+                ChunkFunc &&chunk_func) {
+    if (chunk_num == 0) { return; }
+    if (chunk_num == 1) {
+        chunk_func(std::size_t{0});
+        return;
+    }
+
+    auto state = std::make_shared<ChunkState>(chunk_num);
+    const std::size_t helper_num =
+        std::min<std::size_t>(chunk_num - 1, pool.get_thread_num());
+    pool.post_bulk(std::views::iota(std::size_t{0}, helper_num)
+                   | std::views::transform([&](std::size_t /*i*/) {
+                         return [state, &chunk_func] { state->run(chunk_func); };
+                     }));
+
+    state->run(chunk_func);
+    state->wait();
+    if (state->error) { std::rethrow_exception(state->error); }
+}
+
+}  // namespace simple_thread_pool_detail
+
+// 对[begin, end)中的每一个下标i调用f(i)
+template <typename Index, typename F>
+    requires std::is_integral_v<Index>
+void parallel_for(SimpleThreadPool &pool, Index begin, Index end,
+                  std::size_t grain, F &&f) {
+    namespace detail = simple_thread_pool_detail;
+    if (end <= begin) { return; }
+
+    const auto n = static_cast<std::size_t>(end - begin);
+    const std::size_t chunk_num = detail::chunk_count(pool, n, grain);
+    detail::run_chunks(pool, chunk_num, [&](std::size_t chunk) {
+        const auto [first, last] = detail::chunk_range(n, chunk_num, chunk);
+        for (std::size_t i = first; i < last; ++i) {
+            f(static_cast<Index>(begin + static_cast<Index>(i)));
+        }
+    });
+}
+
+template <typename Index, typename F>
+    requires std::is_integral_v<Index>
+void parallel_for(SimpleThreadPool &pool, Index begin, Index end, F &&f) {
+    parallel_for(pool, begin, end, 0, std::forward<F>(f));
+}
+
+// 与std::reduce相同，op需要满足结合律，结果按照元素顺序合并，与线程数无关
+template <std::random_access_iterator Iter, typename T,
+          typename BinaryOp = std::plus<>>
+T parallel_reduce(SimpleThreadPool &pool, Iter first, Iter last, T init,
+                  BinaryOp op = {}, std::size_t grain = 0) {
+    namespace detail = simple_thread_pool_detail;
+    if (last <= first) { return init; }
+
+    const auto n = static_cast<std::size_t>(last - first);
+    const std::size_t chunk_num = detail::chunk_count(pool, n, grain);
+    std::vector<std::optional<T>> partials(chunk_num);
+
+    detail::run_chunks(pool, chunk_num, [&](std::size_t chunk) {
+        const auto [begin, end] = detail::chunk_range(n, chunk_num, chunk);
+        if (begin == end) { return; }
+
+        T sum = first[begin];
+        for (std::size_t i = begin + 1; i < end; ++i) {
+            sum = op(std::move(sum), first[i]);
+        }
+        partials[chunk] = std::move(sum);
+    });
+
+    for (auto &partial : partials) {
+        if (partial) { init = op(std::move(init), std::move(*partial)); }
+    }
+    return init;
+}
+
+// 与std::transform相同，输出区间可以与输入区间重合，返回输出的末尾
+template <std::random_access_iterator Iter,
+          std::random_access_iterator OutIter, typename UnaryOp>
+OutIter parallel_transform(SimpleThreadPool &pool, Iter first, Iter last,
+                           OutIter d_first, UnaryOp op,
+                           std::size_t grain = 0) {
+    namespace detail = simple_thread_pool_detail;
+    if (last <= first) { return d_first; }
+
+    const auto n = static_cast<std::size_t>(last - first);
+    const std::size_t chunk_num = detail::chunk_count(pool, n, grain);
+    detail::run_chunks(pool, chunk_num, [&](std::size_t chunk) {
+        const auto [begin, end] = detail::chunk_range(n, chunk_num, chunk);
+        std::transform(first + begin, first + end, d_first + begin, op);
+    });
+    return d_first + n;
+}
+
+// 与std::inclusive_scan相同，op需要满足结合律，输出区间可以与输入区间重合
+// 分两遍执行: 先并行求出每一块的和，串行求出每一块之前的前缀，再并行扫描每一块
+template <std::random_access_iterator Iter,
+          std::random_access_iterator OutIter, typename BinaryOp = std::plus<>>
+OutIter parallel_scan(SimpleThreadPool &pool, Iter first, Iter last,
+                      OutIter d_first, BinaryOp op = {},
+                      std::size_t grain = 0) {
+    namespace detail = simple_thread_pool_detail;
+    using T = typename std::iterator_traits<Iter>::value_type;
+    if (last <= first) { return d_first; }
+
+    const auto n = static_cast<std::size_t>(last - first);
+    const std::size_t chunk_num = detail::chunk_count(pool, n, grain);
+    std::vector<std::optional<T>> sums(chunk_num);
+
+    detail::run_chunks(pool, chunk_num, [&](std::size_t chunk) {
+        const auto [begin, end] = detail::chunk_range(n, chunk_num, chunk);
+        if (begin == end) { return; }
+
+        T sum = first[begin];
+        for (std::size_t i = begin + 1; i < end; ++i) {
+            sum = op(std::move(sum), first[i]);
+        }
+        sums[chunk] = std::move(sum);
+    });
+
+    // 把每一块的和替换为这一块之前所有元素的前缀，第一块没有前缀
+    std::optional<T> prefix;
+    for (auto &sum : sums) {
+        if (!sum) { continue; }
+        std::optional<T> next =
+            prefix ? std::optional<T>(op(*prefix, *sum)) : std::move(sum);
+        sum = std::move(prefix);
+        prefix = std::move(next);
+    }
+
+    detail::run_chunks(pool, chunk_num, [&](std::size_t chunk) {
+        const auto [begin, end] = detail::chunk_range(n, chunk_num, chunk);
+        if (begin == end) { return; }
+
+        T sum = sums[chunk] ? op(*sums[chunk], first[begin]) : T(first[begin]);
+        for (std::size_t i = begin + 1; i < end; ++i) {
+            T next = op(sum, first[i]);
+            d_first[i - 1] = std::move(sum);
+            sum = std::move(next);
+        }
+        d_first[end - 1] = std::move(sum);
+    });
+    return d_first + n;
+}
@@ -1,123 +1,2283 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <bit>
+#include <chrono>
+#include <concepts>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <future>
+#include <limits>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <new>
+#include <optional>
+#include <ranges>
+#include <stdexcept>
+#include <system_error>
 #include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace simple_thread_pool_detail {
+
+// 忙等的循环中调用，提示CPU这是自旋，降低功耗并把流水线让给同一核心的超线程
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// 把线程绑定到一组CPU上，只在Linux上支持，不支持或者失败时返回false
+inline bool set_thread_affinity(std::thread &thread,
+                                const std::vector<std::uint32_t> &cpus) {
+#if defined(__linux__)
+    if (cpus.empty()) { return false; }
+
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (std::uint32_t cpu : cpus) {
+        if (cpu >= CPU_SETSIZE) { return false; }
+        CPU_SET(cpu, &cpu_set);
+    }
+    return pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set),
+                                  &cpu_set)
+           == 0;
+#else
+    (void)thread;
+    (void)cpus;
+    return false;
+#endif
+}
+
+// 小对象内存池，用于任务节点和future的共享状态
+// 按照大小分为几档，每个线程有一个本地的空闲链表，
+// 过长时按批归还到全局链表，为空时从全局链表按批取回
+// 任务在提交线程分配、在执行线程释放，内存通过全局链表循环使用，
+// 稳定运行时不再向系统申请内存，也只是每一批加一次锁
+// 超过最大一档的对象直接使用operator new
+// 本线程的缓存或者全局链表已经析构以后(程序退出时析构的全局对象)，
+// 同样直接使用operator new/delete
+class SmallObjectPool {
+public:
+    constexpr static std::size_t max_size = 256;
+
+    SmallObjectPool(const SmallObjectPool &) = delete;
+    SmallObjectPool &operator=(const SmallObjectPool &) = delete;
+
+    static void *allocate(std::size_t size) {
+        if (size > max_size) { return ::operator new(size); }
+
+        const std::size_t index = class_index(size);
+        if (torn_down()) { return ::operator new(class_size(index)); }
+
+        FreeList &list = get_local_cache().lists[index];
+        if (list.head == nullptr) {
+            list = get_instance().take_batch(index);
+            if (list.head == nullptr) {
+                return ::operator new(class_size(index));
+            }
+        }
+
+        FreeNode *node = list.head;
+        list.head = node->next;
+        --list.count;
+        return node;
+    }
+
+    static void deallocate(void *ptr, std::size_t size) noexcept {
+        if (size > max_size || torn_down()) {
+            ::operator delete(ptr);
+            return;
+        }
+
+        const std::size_t index = class_index(size);
+        FreeList &list = get_local_cache().lists[index];
+        list.head = ::new (ptr) FreeNode{list.head};
+        ++list.count;
+
+        // 保留一批供本线程继续使用，多出的一批归还
+        if (list.count >= 2 * batch_size) {
+            FreeNode *last = list.head;
+            for (std::size_t i = 1; i < batch_size; ++i) { last = last->next; }
+            FreeList batch{list.head, batch_size};
+            list.head = last->next;
+            list.count -= batch_size;
+            last->next = nullptr;
+            get_instance().give_batch(index, batch);
+        }
+    }
+
+    // 提前构造全局链表，使它晚于调用者析构
+    static void init() { get_instance(); }
+
+private:
+    constexpr static std::size_t class_num = 3;  // 64、128、256字节
+    constexpr static std::size_t batch_size = 32;
+
+    struct FreeNode {
+        FreeNode *next;
+    };
+
+    struct FreeList {
+        FreeNode *head{nullptr};
+        std::size_t count{0};
+    };
+
+    // 线程退出时把剩余的内存全部归还
+    struct LocalCache {
+        LocalCache() = default;
+        LocalCache(const LocalCache &) = delete;
+        LocalCache &operator=(const LocalCache &) = delete;
+
+        ~LocalCache() {
+            cache_torn_down() = true;
+            for (std::size_t i = 0; i < class_num; ++i) {
+                if (lists[i].head == nullptr) { continue; }
+                if (pool_torn_down().load()) { delete_list(lists[i]); }
+                else { get_instance().give_batch(i, lists[i]); }
+                lists[i] = FreeList{};
+            }
+        }
+
+        FreeList lists[class_num];
+    };
+
+    static constexpr std::size_t class_index(std::size_t size) {
+        std::size_t index = 0;
+        while (class_size(index) < size) { ++index; }
+        return index;
+    }
+
+    static constexpr std::size_t class_size(std::size_t index) {
+        return std::size_t{64} << index;
+    }
+
+    FreeList take_batch(std::size_t index) {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        auto &batches = m_batches[index];
+        if (batches.empty()) { return {}; }
+        FreeList batch = batches.back();
+        batches.pop_back();
+        return batch;
+    }
+
+    void give_batch(std::size_t index, FreeList batch) {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_batches[index].push_back(batch);
+    }
+
+    static LocalCache &get_local_cache() {
+        thread_local LocalCache the_cache;
+        return the_cache;
+    }
+
+    // 两个标志都没有析构函数，析构以后的对象仍然可以读取
+    static bool &cache_torn_down() {
+        thread_local bool the_flag = false;
+        return the_flag;
+    }
+
+    static std::atomic_bool &pool_torn_down() {
+        static std::atomic_bool the_flag{false};
+        return the_flag;
+    }
+
+    static bool torn_down() {
+        return cache_torn_down() || pool_torn_down().load();
+    }
+
+    static void delete_list(FreeList list) {
+        while (list.head != nullptr) {
+            FreeNode *next = list.head->next;
+            ::operator delete(list.head);
+            list.head = next;
+        }
+    }
+
+    static SmallObjectPool &get_instance() {
+        static SmallObjectPool the_pool;
+        return the_pool;
+    }
+
+    SmallObjectPool() = default;
+
+    ~SmallObjectPool() {
+        pool_torn_down().store(true);
+        for (auto &batches : m_batches) {
+            for (FreeList batch : batches) { delete_list(batch); }
+        }
+    }
+
+    std::mutex m_mtx;
+    std::vector<FreeList> m_batches[class_num];
+};
+
+// 从SmallObjectPool分配的分配器，用于std::promise的共享状态
+template <typename T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    PoolAllocator() = default;
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> & /*other*/) noexcept {}
+
+    T *allocate(std::size_t n) {
+        if constexpr (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            return static_cast<T *>(
+                ::operator new(n * sizeof(T), std::align_val_t{alignof(T)}));
+        }
+        else {
+            return static_cast<T *>(SmallObjectPool::allocate(n * sizeof(T)));
+        }
+    }
+
+    void deallocate(T *ptr, std::size_t n) noexcept {
+        if constexpr (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            ::operator delete(ptr, std::align_val_t{alignof(T)});
+        }
+        else {
+            SmallObjectPool::deallocate(ptr, n * sizeof(T));
+        }
+    }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U> & /*other*/) const noexcept {
+        return true;
+    }
+};
+
+// 只能移动的任务
+// 不超过inline_size、可以无异常移动的可调用对象直接保存在内部的缓冲区中，
+// 其它的放在堆上
+class Task {
+public:
+    constexpr static std::size_t inline_size = 64;
+
+    Task() = default;
+
+    template <typename F>
+        requires(!std::is_same_v<std::decay_t<F>, Task>)
+    Task(F &&func) {  // NOLINT(google-explicit-constructor)
+        using Fn = std::decay_t<F>;
+        if constexpr (fits_inline<Fn>) {
+            ::new (static_cast<void *>(m_storage)) Fn(std::forward<F>(func));
+            m_ops = &inline_ops<Fn>;
+        }
+        else {
+            ::new (static_cast<void *>(m_storage))
+                Fn *(new Fn(std::forward<F>(func)));
+            m_ops = &heap_ops<Fn>;
+        }
+    }
+
+    ~Task() { reset(); }
+
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    Task(Task &&other) noexcept { take(other); }
+
+    Task &operator=(Task &&other) noexcept {
+        if (this != &other) {
+            reset();
+            take(other);
+        }
+        return *this;
+    }
+
+    void operator()() { m_ops->invoke(m_storage); }
+
+    explicit operator bool() const { return m_ops != nullptr; }
+
+    template <typename Fn>
+    constexpr static bool fits_inline =
+        sizeof(Fn) <= inline_size && alignof(Fn) <= alignof(std::max_align_t)
+        && std::is_nothrow_move_constructible_v<Fn>;
+
+private:
+    struct Ops {
+        void (*invoke)(void *storage);
+        void (*relocate)(void *to, void *from) noexcept;
+        void (*destroy)(void *storage) noexcept;
+    };
+
+    template <typename Fn>
+    static Fn *inline_target(void *storage) {
+        return std::launder(static_cast<Fn *>(storage));
+    }
+
+    template <typename Fn>
+    static Fn *heap_target(void *storage) {
+        return *std::launder(static_cast<Fn **>(storage));
+    }
+
+    template <typename Fn>
+    constexpr static Ops inline_ops{
+        [](void *storage) { (*inline_target<Fn>(storage))(); },
+        [](void *to, void *from) noexcept {
+            Fn *source = inline_target<Fn>(from);
+            ::new (to) Fn(std::move(*source));
+            source->~Fn();
+        },
+        [](void *storage) noexcept { inline_target<Fn>(storage)->~Fn(); }};
+
+    template <typename Fn>
+    constexpr static Ops heap_ops{
+        [](void *storage) { (*heap_target<Fn>(storage))(); },
+        [](void *to, void *from) noexcept {
+            ::new (to) Fn *(heap_target<Fn>(from));
+        },
+        [](void *storage) noexcept { delete heap_target<Fn>(storage); }};
+
+    void reset() noexcept {
+        if (m_ops != nullptr) {
+            m_ops->destroy(m_storage);
+            m_ops = nullptr;
+        }
+    }
+
+    void take(Task &other) noexcept {
+        if (other.m_ops != nullptr) {
+            other.m_ops->relocate(m_storage, other.m_storage);
+            m_ops = other.m_ops;
+            other.m_ops = nullptr;
+        }
+    }
+
+    alignas(std::max_align_t) unsigned char m_storage[inline_size];
+    const Ops *m_ops{nullptr};
+};
+
+// 队列中的任务节点，从SmallObjectPool分配
+// 两种调度方式的队列都只保存节点的指针，入队出队不再分配内存
+struct TaskNode {
+    using Clock = std::chrono::steady_clock;
+
+    template <typename F>
+    explicit TaskNode(F &&func) : task(std::forward<F>(func)) {}
+
+    Task task;
+    TaskNode *next{nullptr};
+    Clock::time_point enqueue_time;  // 入队时间，用于统计排队延迟
+    Clock::time_point deadline;      // 最晚开始时间
+    std::uint8_t priority{1};        // 0最高
+    bool has_deadline{false};
+
+    template <typename F>
+    static TaskNode *create(F &&func) {
+        void *memory = SmallObjectPool::allocate(sizeof(TaskNode));
+        try {
+            return ::new (memory) TaskNode(std::forward<F>(func));
+        }
+        catch (...) {
+            SmallObjectPool::deallocate(memory, sizeof(TaskNode));
+            throw;
+        }
+    }
+
+    static void destroy(TaskNode *node) noexcept {
+        node->~TaskNode();
+        SmallObjectPool::deallocate(node, sizeof(TaskNode));
+    }
+};
+
+// 由节点串成的先进先出队列，不负责加锁
+class TaskList {
+public:
+    void push_back(TaskNode *node) {
+        node->next = nullptr;
+        if (m_tail != nullptr) { m_tail->next = node; }
+        else { m_head = node; }
+        m_tail = node;
+    }
+
+    // 队列为空时返回nullptr
+    TaskNode *pop_front() {
+        TaskNode *node = m_head;
+        if (node != nullptr) {
+            m_head = node->next;
+            if (m_head == nullptr) { m_tail = nullptr; }
+        }
+        return node;
+    }
+
+    bool empty() const { return m_head == nullptr; }
+
+private:
+    TaskNode *m_head{nullptr};
+    TaskNode *m_tail{nullptr};
+};
+
+// 按优先级分开的任务队列，不负责加锁
+// 每个优先级有一个先进先出的链表和一个按截止时间排序的堆，
+// 同一优先级中带有截止时间的任务先于没有截止时间的任务，按截止时间先后取出
+// 已经超过截止时间的任务不论优先级总是最先取出
+// 没有截止时间时入队和出队都是O(1)
+class PriorityTaskQueue {
+public:
+    constexpr static std::size_t priority_num = 3;
+
+    void push(TaskNode *node) {
+        Level &level = m_levels[node->priority];
+        if (node->has_deadline) {
+            level.deadlines.push_back(node);
+            std::ranges::push_heap(level.deadlines, later_deadline);
+            ++m_deadline_num;
+        }
+        else {
+            level.fifo.push_back(node);
+            ++level.fifo_num;
+        }
+        ++m_size;
+    }
+
+    // 只取出优先级不低于max_priority的任务(以及超过截止时间的任务)
+    // 没有这样的任务时返回nullptr
+    TaskNode *pop(std::size_t max_priority = priority_num - 1) {
+        if (m_size == 0) { return nullptr; }
+        if (m_deadline_num > 0) {
+            if (TaskNode *node = pop_overdue()) { return node; }
+        }
+
+        for (std::size_t p = 0; p <= max_priority; ++p) {
+            Level &level = m_levels[p];
+            if (!level.deadlines.empty()) { return pop_deadline(level); }
+            if (TaskNode *node = level.fifo.pop_front()) {
+                --level.fifo_num;
+                --m_size;
+                return node;
+            }
+        }
+        return nullptr;
+    }
+
+    bool empty() const { return m_size == 0; }
+
+    std::size_t size() const { return m_size; }
+
+    // 最高优先级的任务数
+    std::size_t high_size() const {
+        return m_levels[0].fifo_num + m_levels[0].deadlines.size();
+    }
+
+    // 其它优先级中最早的截止时间，没有时返回time_point::max()
+    // 到达这个时间以后pop会先取出超过截止时间的任务
+    TaskNode::Clock::time_point earliest_deadline() const {
+        auto earliest = TaskNode::Clock::time_point::max();
+        for (std::size_t p = 1; p < priority_num; ++p) {
+            if (!m_levels[p].deadlines.empty()) {
+                earliest =
+                    std::min(earliest, m_levels[p].deadlines.front()->deadline);
+            }
+        }
+        return earliest;
+    }
+
+private:
+    struct Level {
+        TaskList fifo;
+        std::size_t fifo_num{0};
+        std::vector<TaskNode *> deadlines;  // 截止时间最早的在堆顶
+    };
+
+    static bool later_deadline(const TaskNode *a, const TaskNode *b) {
+        return a->deadline > b->deadline;
+    }
+
+    TaskNode *pop_deadline(Level &level) {
+        std::ranges::pop_heap(level.deadlines, later_deadline);
+        TaskNode *node = level.deadlines.back();
+        level.deadlines.pop_back();
+        --m_deadline_num;
+        --m_size;
+        return node;
+    }
+
+    TaskNode *pop_overdue() {
+        const auto now = TaskNode::Clock::now();
+        Level *earliest = nullptr;
+        for (Level &level : m_levels) {
+            if (!level.deadlines.empty()
+                && level.deadlines.front()->deadline <= now
+                && (earliest == nullptr
+                    || level.deadlines.front()->deadline
+                           < earliest->deadlines.front()->deadline)) {
+                earliest = &level;
+            }
+        }
+        return (earliest != nullptr) ? pop_deadline(*earliest) : nullptr;
+    }
+
+    std::array<Level, priority_num> m_levels;
+    std::size_t m_size{0};
+    std::size_t m_deadline_num{0};
+};
+
+// Chase-Lev工作窃取双端队列，参考Lê等人在C11内存模型下的实现
+// 只有所属的线程可以在底部push和pop(后进先出)，其它线程从顶部steal(先进先出)
+// 元素必须可以平凡复制，通常是指针
+// 扩容后旧的数组保留到析构，因为正在steal的线程可能仍在读取
+template <typename T>
+class WorkStealingDeque {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+    explicit WorkStealingDeque(std::size_t capacity = 256) {
+        std::size_t size = 2;
+        while (size < capacity) { size <<= 1; }
+        m_arrays.push_back(std::make_unique<Array>(size));
+        m_array.store(m_arrays.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque &) = delete;
+    WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+    // 只能由所属的线程调用
+    void push(T value) {
+        const std::int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+        const std::int64_t top = m_top.load(std::memory_order_acquire);
+        Array *array = m_array.load(std::memory_order_relaxed);
+        if (bottom - top > static_cast<std::int64_t>(array->mask)) {
+            array = grow(array, top, bottom);
+        }
+
+        array->put(bottom, value);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    // 只能由所属的线程调用，队列为空时返回nullopt
+    std::optional<T> pop() {
+        const std::int64_t bottom =
+            m_bottom.load(std::memory_order_relaxed) - 1;
+        Array *array = m_array.load(std::memory_order_relaxed);
+        m_bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t top = m_top.load(std::memory_order_relaxed);
+
+        if (top > bottom) {
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+
+        T value = array->get(bottom);
+        if (top == bottom) {
+            // 只剩最后一个元素，与steal竞争
+            const bool won = m_top.compare_exchange_strong(
+                top, top + 1, std::memory_order_seq_cst,
+                std::memory_order_relaxed);
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            if (!won) { return std::nullopt; }
+        }
+        return value;
+    }
+
+    // 可以由任意线程调用，队列为空或者竞争失败时返回nullopt
+    std::optional<T> steal() {
+        std::int64_t top = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const std::int64_t bottom = m_bottom.load(std::memory_order_acquire);
+        if (top >= bottom) { return std::nullopt; }
+
+        Array *array = m_array.load(std::memory_order_acquire);
+        T value = array->get(top);
+        if (!m_top.compare_exchange_strong(top, top + 1,
+                                           std::memory_order_seq_cst,
+                                           std::memory_order_relaxed)) {
+            return std::nullopt;
+        }
+        return value;
+    }
+
+    // 其它线程读取时只是一个近似值
+    bool empty() const {
+        return m_bottom.load(std::memory_order_acquire)
+               <= m_top.load(std::memory_order_acquire);
+    }
+
+    // 同empty()，只是一个近似值
+    std::size_t size() const {
+        const std::int64_t bottom = m_bottom.load(std::memory_order_acquire);
+        const std::int64_t top = m_top.load(std::memory_order_acquire);
+        return (bottom > top) ? static_cast<std::size_t>(bottom - top) : 0;
+    }
+
+private:
+    struct Array {
+        explicit Array(std::size_t size)
+            : mask(size - 1),
+              data(std::make_unique<std::atomic<T>[]>(size)) {}
+
+        T get(std::int64_t index) const {
+            return data[static_cast<std::size_t>(index) & mask].load(
+                std::memory_order_relaxed);
+        }
+
+        void put(std::int64_t index, T value) {
+            data[static_cast<std::size_t>(index) & mask].store(
+                value, std::memory_order_relaxed);
+        }
+
+        const std::size_t mask;
+        std::unique_ptr<std::atomic<T>[]> data;
+    };
+
+    Array *grow(Array *array, std::int64_t top, std::int64_t bottom) {
+        auto bigger = std::make_unique<Array>((array->mask + 1) * 2);
+        for (std::int64_t i = top; i < bottom; ++i) {
+            bigger->put(i, array->get(i));
+        }
+        m_arrays.push_back(std::move(bigger));
+        array = m_arrays.back().get();
+        m_array.store(array, std::memory_order_release);
+        return array;
+    }
+
+    // 所属线程和窃取线程访问的位置分开放在不同的缓存行，避免伪共享
+    alignas(64) std::atomic<std::int64_t> m_top{0};
+    alignas(64) std::atomic<std::int64_t> m_bottom{0};
+    std::atomic<Array *> m_array{nullptr};
+    std::vector<std::unique_ptr<Array>> m_arrays;  // 只由所属线程修改
+};
+
+// HDR风格的对数分桶: 小于16的值各占一个桶，
+// 之后每个2的幂区间等分为16个桶，桶的宽度不超过下界的1/16
+constexpr std::size_t histogram_sub_bucket_bits = 4;
+constexpr std::size_t histogram_sub_bucket_num = 1
+                                                 << histogram_sub_bucket_bits;
+constexpr std::size_t histogram_bucket_num =
+    (64 - histogram_sub_bucket_bits + 1) * histogram_sub_bucket_num;
+
+inline std::size_t histogram_bucket(std::uint64_t value) {
+    if (value < histogram_sub_bucket_num) { return value; }
+    const auto shift = static_cast<std::size_t>(std::bit_width(value)) - 1
+                       - histogram_sub_bucket_bits;
+    return (shift + 1) * histogram_sub_bucket_num
+           + ((value >> shift) & (histogram_sub_bucket_num - 1));
+}
+
+// 桶的下界，桶内的值为[lower, lower + 2^shift)
+inline std::uint64_t histogram_bucket_lower(std::size_t index) {
+    if (index < histogram_sub_bucket_num) { return index; }
+    const std::size_t shift = index / histogram_sub_bucket_num - 1;
+    return static_cast<std::uint64_t>(histogram_sub_bucket_num
+                                      + index % histogram_sub_bucket_num)
+           << shift;
+}
+
+inline std::uint64_t histogram_bucket_upper(std::size_t index) {
+    if (index < histogram_sub_bucket_num) { return index; }
+    const std::size_t shift = index / histogram_sub_bucket_num - 1;
+    return histogram_bucket_lower(index) + ((std::uint64_t{1} << shift) - 1);
+}
+
+// 可以并发记录的直方图
+struct AtomicHistogram {
+    void record(std::uint64_t value) {
+        counts[histogram_bucket(value)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(value, std::memory_order_relaxed);
+        std::uint64_t current = max.load(std::memory_order_relaxed);
+        while (value > current
+               && !max.compare_exchange_weak(current, value,
+                                             std::memory_order_relaxed)) {}
+    }
+
+    void reset() {
+        for (auto &count : counts) { count.store(0, std::memory_order_relaxed); }
+        total.store(0, std::memory_order_relaxed);
+        max.store(0, std::memory_order_relaxed);
+    }
+
+    std::array<std::atomic<std::uint64_t>, histogram_bucket_num> counts{};
+    std::atomic<std::uint64_t> total{0};
+    std::atomic<std::uint64_t> max{0};
+};
+
+}  // namespace simple_thread_pool_detail
+
 class SimpleThreadPool {
 public:
+    // 任务的调度方式
+    enum class Mode {
+        // 所有线程共用一个加锁的任务队列
+        SHARED_QUEUE,
+        // 每个线程有一个本地的双端队列，线程内提交的任务放入自己的队列，
+        // 外部提交的任务放入全局队列，空闲的线程从其它线程的队列窃取任务
+        WORK_STEALING,
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    // 任务的优先级，同一时刻总是先执行优先级高的任务
+    // 工作窃取模式下，线程池内提交的NORMAL任务仍然放入本地队列
+    enum class Priority : std::uint8_t {
+        HIGH,
+        NORMAL,
+        LOW,
+    };
+
+    // 提交任务时的选项，可以由Priority隐式转换
+    // deadline为最晚开始时间，同一优先级中先于没有截止时间的任务执行，
+    // 已经超过截止时间的任务不论优先级最先执行
+    struct TaskOptions {
+        // NOLINTNEXTLINE(google-explicit-constructor)
+        TaskOptions(Priority p = Priority::NORMAL) : priority(p) {}
+
+        TaskOptions(Priority p, Clock::time_point d)
+            : priority(p), deadline(d) {}
+
+        Priority priority;
+        std::optional<Clock::time_point> deadline;
+    };
+
+    // 某一优先级的任务从提交到开始执行的排队延迟
+    struct QueueStats {
+        std::uint64_t task_num{0};
+        std::uint64_t total_wait_ns{0};
+        std::uint64_t max_wait_ns{0};
+        std::uint64_t deadline_missed{0};  // 超过截止时间才开始执行的任务数
+
+        double average_wait_ns() const {
+            return (task_num > 0) ? static_cast<double>(total_wait_ns)
+                                        / static_cast<double>(task_num)
+                                  : 0.0;
+        }
+    };
+
+    // 空闲线程的等待策略
+    // 没有任务时先忙等spin_time，再用yield让出CPU等待yield_time，然后才睡眠
+    // 自旋期间提交的任务不需要通过条件变量唤醒线程，分发延迟更低，
+    // 代价是空闲时占用CPU；默认都为0，没有任务时直接睡眠
+    struct IdlePolicy {
+        std::chrono::nanoseconds spin_time{0};
+        std::chrono::nanoseconds yield_time{0};
+    };
+
+    // 空闲的线程拿到任务时，任务从提交到开始执行的延迟
+    // 按照拿到任务前是在自旋还是已经睡眠分别统计
+    struct WakeupStats {
+        std::uint64_t spin_num{0};
+        std::uint64_t spin_total_ns{0};
+        std::uint64_t spin_max_ns{0};
+        std::uint64_t park_num{0};
+        std::uint64_t park_total_ns{0};
+        std::uint64_t park_max_ns{0};
+
+        double average_spin_ns() const {
+            return (spin_num > 0) ? static_cast<double>(spin_total_ns)
+                                        / static_cast<double>(spin_num)
+                                  : 0.0;
+        }
+
+        double average_park_ns() const {
+            return (park_num > 0) ? static_cast<double>(park_total_ns)
+                                        / static_cast<double>(park_num)
+                                  : 0.0;
+        }
+    };
+
+    // 延迟的分布，单位为纳秒
+    // HDR风格的对数分桶，分位数的相对误差不超过1/16
+    struct Histogram {
+        constexpr static std::size_t bucket_num =
+            simple_thread_pool_detail::histogram_bucket_num;
+
+        std::array<std::uint64_t, bucket_num> counts{};
+        std::uint64_t count{0};
+        std::uint64_t total_ns{0};
+        std::uint64_t max_ns{0};
+
+        double average_ns() const {
+            return (count > 0) ? static_cast<double>(total_ns)
+                                     / static_cast<double>(count)
+                               : 0.0;
+        }
+
+        // 分位数，q在[0, 1]之间，返回所在桶的上界(不超过最大值)
+        std::uint64_t percentile_ns(double q) const {
+            if (count == 0) { return 0; }
+            const auto rank = static_cast<std::uint64_t>(
+                std::clamp(q, 0.0, 1.0) * static_cast<double>(count - 1));
+            std::uint64_t seen = 0;
+            for (std::size_t i = 0; i < bucket_num; ++i) {
+                seen += counts[i];
+                if (seen > rank) {
+                    return std::min(
+                        simple_thread_pool_detail::histogram_bucket_upper(i),
+                        max_ns);
+                }
+            }
+            return max_ns;
+        }
+
+        // 值为value_ns的桶的编号
+        static std::size_t bucket_of(std::uint64_t value_ns) {
+            return simple_thread_pool_detail::histogram_bucket(value_ns);
+        }
+    };
+
+    // 线程池的遥测数据，用于在生产环境中确定线程池的大小
+    struct Telemetry {
+        std::uint64_t submitted_num{0};
+        std::uint64_t completed_num{0};
+        std::uint64_t discarded_num{0};       // cancel()丢弃的任务数
+        std::uint64_t queue_depth{0};         // 正在排队(还没有开始)的任务数
+        std::uint64_t pending_high_water{0};  // 排队和执行中的任务数的最大值
+        Histogram wait;                       // 从提交到开始执行的排队延迟
+        Histogram run;                        // 执行时间
+    };
+
+    // 弹性伸缩的策略
+    // 所有线程都在执行任务时提交新任务会增加一个线程，最多max_thread_num个；
+    // 线程空闲超过idle_timeout时退出，至少保留min_thread_num个
+    // max_thread_num为0时关闭弹性伸缩(默认)
+    struct ElasticPolicy {
+        std::uint32_t min_thread_num{1};
+        std::uint32_t max_thread_num{0};
+        std::chrono::milliseconds idle_timeout{1000};
+    };
+
+    // 工作窃取模式下同时存在的线程数的上限(本地队列的个数)，
+    // 构造时指定更多的线程时以构造时为准
+    constexpr static uint32_t max_stealing_thread_num = 256;
+
     // 构造时自动开启线程池
-    explicit SimpleThreadPool(uint32_t thread_num)
-        : m_thread_num(thread_num > 0 ? thread_num : 1) {
+    explicit SimpleThreadPool(uint32_t thread_num,
+                              Mode mode = Mode::SHARED_QUEUE)
+        : SimpleThreadPool(thread_num, mode, IdlePolicy{}) {}
+
+    SimpleThreadPool(uint32_t thread_num, Mode mode,
+                     const IdlePolicy &idle_policy)
+        : m_thread_num(thread_num > 0 ? thread_num : 1), m_mode(mode) {
+        simple_thread_pool_detail::SmallObjectPool::init();
+        set_idle_policy(idle_policy);
         start();
     }
 
-    // 析构时自动关闭线程池
-    ~SimpleThreadPool() { stop(); }
+    // 析构时等待已经提交的任务全部执行完再关闭线程池，见drain()
+    // 在线程池自己的任务中析构时不能等待(当前任务就是其中之一)，
+    // 此时合并其它线程并丢弃排队的任务，当前线程被分离，任务返回后直接结束
+    ~SimpleThreadPool() {
+        if (current_worker().pool == this) { destroy_in_worker(); }
+        else { drain(); }
+    }
+
+    // 禁止复制
+    SimpleThreadPool(const SimpleThreadPool &) = delete;
+    SimpleThreadPool &operator=(const SimpleThreadPool &) = delete;
+
+    // 提交任务，含参数，返回future
+    // 任务和future的共享状态都从内存池分配，较小的任务在稳定运行时不分配内存
+    template <class F, class... Args>
+        requires std::invocable<F, Args...>
+    auto commit(F &&f, Args &&...args) {
+        return commit(TaskOptions{}, std::forward<F>(f),
+                      std::forward<Args>(args)...);
+    }
+
+    // 按照指定的优先级和截止时间提交任务
+    template <class F, class... Args>
+    auto commit(const TaskOptions &options, F &&f, Args &&...args) {
+        // 返回类型
+        using RetType = std::invoke_result_t<F, Args...>;
+
+        // 如果线程池已经停止，直接返回空的future
+        check_accepting();
+
+        auto promise = make_promise<RetType>();
+        std::future<RetType> result = promise.get_future();
+        push_task(make_node(options,
+                            make_promise_task(std::move(promise),
+                                              std::forward<F>(f),
+                                              std::forward<Args>(args)...)));
+
+        return result;  // 返回future对象
+    }
+
+    // 批量提交一组无参数的可调用对象，返回顺序一致的future
+    // 整批任务只加一次锁，并且按照任务数唤醒线程，而不是每个任务唤醒一次
+    // callables为右值时移动其中的元素，否则复制
+    template <std::ranges::input_range R>
+        requires std::invocable<std::ranges::range_value_t<R> &>
+    auto commit_bulk(R &&callables, const TaskOptions &options = {}) {
+        using RetType = std::invoke_result_t<std::ranges::range_value_t<R> &>;
+
+        check_accepting();
+
+        std::vector<std::future<RetType>> results;
+        if constexpr (std::ranges::sized_range<R>) {
+            results.reserve(std::ranges::size(callables));
+        }
+
+        simple_thread_pool_detail::TaskList tasks;
+        std::size_t task_num = 0;
+        try {
+            for (auto &&callable : callables) {
+                auto promise = make_promise<RetType>();
+                results.push_back(promise.get_future());
+                tasks.push_back(make_node(
+                    options, make_promise_task(std::move(promise),
+                                               take_element<R>(callable))));
+                ++task_num;
+            }
+        }
+        catch (...) {
+            while (Node *task = tasks.pop_front()) { Node::destroy(task); }
+            throw;
+        }
+
+        push_tasks(tasks, task_num);
+        return results;
+    }
+
+    // 提交不需要结果的任务，不创建future
+    // 任务抛出的异常无处传递，与std::thread一样会调用std::terminate
+    template <class F, class... Args>
+        requires std::invocable<F, Args...>
+    void post(F &&f, Args &&...args) {
+        post(TaskOptions{}, std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    template <class F, class... Args>
+    void post(const TaskOptions &options, F &&f, Args &&...args) {
+        check_accepting();
+
+        push_task(make_node(options,
+                            [func = std::forward<F>(f),
+                             ... args = std::forward<Args>(args)]() mutable {
+                                func(std::forward<Args>(args)...);
+                            }));
+    }
+
+    // 批量提交不需要结果的任务，与commit_bulk相同只加一次锁
+    template <std::ranges::input_range R>
+        requires std::invocable<std::ranges::range_value_t<R> &>
+    void post_bulk(R &&callables, const TaskOptions &options = {}) {
+        check_accepting();
+
+        simple_thread_pool_detail::TaskList tasks;
+        std::size_t task_num = 0;
+        try {
+            for (auto &&callable : callables) {
+                tasks.push_back(make_node(options, take_element<R>(callable)));
+                ++task_num;
+            }
+        }
+        catch (...) {
+            while (Node *task = tasks.pop_front()) { Node::destroy(task); }
+            throw;
+        }
+
+        push_tasks(tasks, task_num);
+    }
+
+    // 在调用线程中执行一个正在排队的任务，没有任务时返回false
+    // 用于等待其它任务的线程帮助执行，而不是阻塞(见TaskGroup)
+    // 线程池内的线程优先执行自己本地队列中的任务
+    bool run_pending_task() {
+        Node *task = nullptr;
+        if (m_mode == Mode::WORK_STEALING) {
+            const auto &context = current_worker();
+            task = find_task((context.pool == this) ? context.index
+                                                    : m_workers.size());
+        }
+        else {
+            std::lock_guard<std::mutex> mtx_guard(m_mtx);
+            task = m_tasks.pop();
+            m_queued_num.store(m_tasks.size(), std::memory_order_relaxed);
+        }
+
+        if (task == nullptr) { return false; }
+        run_task(task, Wakeup::NONE, Clock::now());
+        return true;
+    }
+
+    // 合并所有线程的计数器
+    QueueStats get_queue_stats(Priority priority) const {
+        QueueStats result;
+        for (const WorkerTelemetry *counters = &m_telemetry_head;
+             counters != nullptr;
+             counters = counters->next.load(std::memory_order_acquire)) {
+            const auto &stats =
+                counters->queue[static_cast<std::size_t>(priority)];
+            result.task_num += stats.task_num.load(std::memory_order_relaxed);
+            result.total_wait_ns +=
+                stats.total_wait_ns.load(std::memory_order_relaxed);
+            result.max_wait_ns =
+                std::max(result.max_wait_ns,
+                         stats.max_wait_ns.load(std::memory_order_relaxed));
+            result.deadline_missed +=
+                stats.deadline_missed.load(std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+    void reset_queue_stats() {
+        for (WorkerTelemetry *counters = &m_telemetry_head;
+             counters != nullptr;
+             counters = counters->next.load(std::memory_order_acquire)) {
+            for (auto &stats : counters->queue) {
+                stats.task_num.store(0, std::memory_order_relaxed);
+                stats.total_wait_ns.store(0, std::memory_order_relaxed);
+                stats.max_wait_ns.store(0, std::memory_order_relaxed);
+                stats.deadline_missed.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // 修改空闲线程的等待策略，已经在自旋的线程在下一次空闲时生效
+    void set_idle_policy(const IdlePolicy &policy) {
+        m_spin_ns.store(std::max<std::int64_t>(policy.spin_time.count(), 0),
+                        std::memory_order_relaxed);
+        m_yield_ns.store(std::max<std::int64_t>(policy.yield_time.count(), 0),
+                         std::memory_order_relaxed);
+    }
+
+    IdlePolicy get_idle_policy() const {
+        return IdlePolicy{
+            std::chrono::nanoseconds{m_spin_ns.load(std::memory_order_relaxed)},
+            std::chrono::nanoseconds{
+                m_yield_ns.load(std::memory_order_relaxed)}};
+    }
+
+    WakeupStats get_wakeup_stats() const {
+        const auto &spin = m_wakeup_stats[0];
+        const auto &park = m_wakeup_stats[1];
+        return WakeupStats{spin.num.load(std::memory_order_relaxed),
+                           spin.total_ns.load(std::memory_order_relaxed),
+                           spin.max_ns.load(std::memory_order_relaxed),
+                           park.num.load(std::memory_order_relaxed),
+                           park.total_ns.load(std::memory_order_relaxed),
+                           park.max_ns.load(std::memory_order_relaxed)};
+    }
+
+    void reset_wakeup_stats() {
+        for (auto &stats : m_wakeup_stats) {
+            stats.num.store(0, std::memory_order_relaxed);
+            stats.total_ns.store(0, std::memory_order_relaxed);
+            stats.max_ns.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // 把线程绑定到CPU上，第i个线程绑定到cpu_sets[i % cpu_sets.size()]
+    // 每个集合可以是一个核心，也可以是一组核心(例如一个NUMA节点的所有核心)
+    // 之后新增的线程也按照同样的规则绑定
+    // 不支持的平台上或者绑定失败时返回false，线程仍然可以正常工作
+    bool set_affinity(const std::vector<std::vector<std::uint32_t>> &cpu_sets) {
+        if (cpu_sets.empty()) { return false; }
 
-    // 禁止复制
-    SimpleThreadPool(const SimpleThreadPool &) = delete;
-    SimpleThreadPool &operator=(const SimpleThreadPool &) = delete;
+        std::lock_guard<std::mutex> control_guard(m_control_mtx);
+        join_exited_threads();
+        m_affinity = cpu_sets;
+        bool all_set = true;
+        for (std::size_t i = 0; i < m_pool.size(); ++i) {
+            all_set = simple_thread_pool_detail::set_thread_affinity(
+                          m_pool[i], cpu_sets[i % cpu_sets.size()])
+                      && all_set;
+        }
+        return all_set;
+    }
 
-    // 提交任务，含参数，返回future
-    template <class F, class... Args>
-    auto commit(F &&f, Args &&...args) {
-        // 返回类型
-        using RetType = std::invoke_result_t<F, Args...>;
+    // 调整线程数
+    // 增加时立即创建线程；减少时多余的线程在执行完手上的任务后退出，
+    // 工作窃取模式下退出的线程把本地队列中的任务转移到全局队列，任务不会丢失
+    // 线程池已经关闭时抛出异常
+    void resize(uint32_t thread_num) {
+        thread_num = std::max(thread_num, 1U);
 
-        // 如果线程池已经停止，直接返回空的future
-        if (!m_running.load())
+        std::lock_guard<std::mutex> control_guard(m_control_mtx);
+        if (!m_accepting.load())
             throw std::runtime_error("ThreadPool is stopped.");
+        if (m_mode == Mode::WORK_STEALING && thread_num > m_workers.size())
+            throw std::runtime_error("ThreadPool: too many threads.");
 
-        // 提交任务
-        // 对参数进行完美转发，使用lambda表达式打包可调用对象和参数
-        // 创建packaged_task对象进一步包装
-        auto new_task_ptr = std::make_shared<std::packaged_task<RetType()>>(
-            [func = std::forward<F>(f),
-             ... args = std::forward<Args>(args)]() mutable {
-                return func(std::forward<Args>(args)...);
-            });
+        join_exited_threads();
+        const uint32_t current = m_thread_num.load();
+        if (thread_num > current) {
+            // 先撤销还没有生效的退出请求，再创建不足的线程
+            uint32_t spawn_num = thread_num - current;
+            uint32_t retire_num = m_retire_num.load();
+            while (spawn_num > 0 && retire_num > 0) {
+                if (m_retire_num.compare_exchange_weak(retire_num,
+                                                       retire_num - 1)) {
+                    --spawn_num;
+                    --retire_num;
+                }
+            }
+            for (uint32_t i = 0; i < spawn_num; ++i) { spawn_worker(); }
+        }
+        else if (thread_num < current) {
+            m_retire_num.fetch_add(current - thread_num);
+            // 唤醒睡眠的线程来退出
+            { std::lock_guard<std::mutex> mtx_guard(m_mtx); }
+            m_cv.notify_all();
+        }
+        m_thread_num.store(thread_num);
+    }
+
+    // 设置弹性伸缩的策略，当前线程数不在[min, max]之内时立即调整
+    void set_elastic_policy(const ElasticPolicy &policy) {
+        const bool enabled = (policy.max_thread_num > 0);
+        if (enabled
+            && (policy.min_thread_num == 0
+                || policy.min_thread_num > policy.max_thread_num))
+            throw std::runtime_error("ThreadPool: invalid elastic policy.");
+
+        if (enabled) {
+            const uint32_t thread_num =
+                std::clamp(m_thread_num.load(), policy.min_thread_num,
+                           policy.max_thread_num);
+            if (thread_num != m_thread_num.load()) { resize(thread_num); }
+        }
+
+        std::lock_guard<std::mutex> control_guard(m_control_mtx);
+        m_min_thread_num.store(policy.min_thread_num);
+        m_max_thread_num.store(policy.max_thread_num);
+        m_idle_timeout_ms.store(policy.idle_timeout.count());
+        m_elastic.store(enabled);
+        // 让睡眠的线程按照新的超时时间等待
+        { std::lock_guard<std::mutex> mtx_guard(m_mtx); }
+        m_cv.notify_all();
+    }
+
+    // 关闭线程池，已经提交的任务全部执行完以后才返回
+    // 开始关闭后外部线程不能再提交任务，正在执行的任务仍然可以提交后续任务，
+    // 它们同样会被执行完
+    // 等待期间不持有控制锁，任务中调用set_affinity()等不会死锁，
+    // 但是resize()会因为线程池已经关闭而抛出异常
+    // 不能在线程池自己的线程中调用；重复调用或者在cancel()之后调用没有效果
+    void drain() {
+        if (current_worker().pool == this)
+            throw std::runtime_error("ThreadPool: drain() in worker thread.");
 
-        std::future<RetType> result = new_task_ptr->get_future();
         {
-            std::lock_guard<std::mutex> mtx_guard(m_mtx);
-            m_tasks.emplace([new_task_ptr] { (*new_task_ptr)(); });
+            std::lock_guard<std::mutex> control_guard(m_control_mtx);
+            m_accepting.store(false);
+        }
+        {
+            // 任务结束时会唤醒，超时只是兜底
+            std::unique_lock<std::mutex> mtx_guard(m_mtx);
+            while (!m_done_cv.wait_for(mtx_guard, std::chrono::milliseconds{10},
+                                       [this] {
+                                           return pending_num() == 0
+                                                  || !m_running.load();
+                                       })) {}
         }
 
-        m_cv.notify_one();  // 唤醒一个线程来执行任务
+        std::lock_guard<std::mutex> control_guard(m_control_mtx);
+        stop();
+    }
 
-        return result;  // 返回future对象
+    // 立即关闭线程池，等待正在执行的任务结束，丢弃所有排队的任务
+    // 被丢弃的任务的future得到broken_promise，返回丢弃的任务数
+    // 不能在线程池自己的线程中调用
+    std::size_t cancel() {
+        if (current_worker().pool == this)
+            throw std::runtime_error("ThreadPool: cancel() in worker thread.");
+
+        std::lock_guard<std::mutex> control_guard(m_control_mtx);
+        m_accepting.store(false);
+        return stop();
+    }
+
+    // 是否还可以提交任务
+    bool is_running() const { return m_accepting.load(); }
+
+    // 合并所有线程的计数器，读取时不影响正在执行的线程
+    // 各个计数器分别读取，线程池繁忙时彼此之间可能有很小的出入
+    Telemetry get_telemetry() const {
+        Telemetry telemetry;
+        auto merge = [](Histogram &histogram,
+                        const simple_thread_pool_detail::AtomicHistogram
+                            &counters) {
+            for (std::size_t i = 0; i < Histogram::bucket_num; ++i) {
+                const std::uint64_t count =
+                    counters.counts[i].load(std::memory_order_relaxed);
+                histogram.counts[i] += count;
+                histogram.count += count;
+            }
+            histogram.total_ns +=
+                counters.total.load(std::memory_order_relaxed);
+            histogram.max_ns =
+                std::max(histogram.max_ns,
+                         counters.max.load(std::memory_order_relaxed));
+        };
+
+        // 计数器只增加，减去清零时的值
+        auto since_reset = [](const std::atomic<std::uint64_t> &value,
+                              const std::atomic<std::uint64_t> &base) {
+            const std::uint64_t base_num = base.load(std::memory_order_acquire);
+            const std::uint64_t num = value.load(std::memory_order_relaxed);
+            return (num > base_num) ? num - base_num : 0;
+        };
+
+        for (const WorkerTelemetry *counters = &m_telemetry_head;
+             counters != nullptr;
+             counters = counters->next.load(std::memory_order_acquire)) {
+            telemetry.submitted_num +=
+                since_reset(counters->submitted_num, counters->submitted_base);
+            telemetry.completed_num +=
+                since_reset(counters->completed_num, counters->completed_base);
+            merge(telemetry.wait, counters->wait);
+            merge(telemetry.run, counters->run);
+            telemetry.pending_high_water = std::max(
+                telemetry.pending_high_water,
+                counters->pending_high_water.load(std::memory_order_relaxed));
+        }
+
+        telemetry.discarded_num =
+            since_reset(m_discarded_num, m_discarded_base);
+        telemetry.queue_depth = queued_num();
+        telemetry.pending_high_water =
+            std::max(telemetry.pending_high_water,
+                     m_pending_high_water.load(std::memory_order_relaxed));
+        return telemetry;
+    }
+
+    // 清零遥测数据，最大值从当前的任务数重新开始统计
+    // 提交和完成的计数器还用于计算剩余的任务数，只记录清零时的值
+    void reset_telemetry() {
+        for (WorkerTelemetry *counters = &m_telemetry_head;
+             counters != nullptr;
+             counters = counters->next.load(std::memory_order_acquire)) {
+            counters->submitted_base.store(counters->submitted_num.load(),
+                                           std::memory_order_release);
+            counters->completed_base.store(counters->completed_num.load(),
+                                           std::memory_order_release);
+            counters->wait.reset();
+            counters->run.reset();
+            counters->pending_high_water.store(0, std::memory_order_relaxed);
+        }
+        m_discarded_base.store(m_discarded_num.load(),
+                               std::memory_order_release);
+        m_pending_high_water.store(pending_num(), std::memory_order_relaxed);
     }
 
     // 获取当前可用的线程数量
     uint32_t get_idle_thread_num() const { return m_idle_thread_num; }
 
     // 获取线程池实例的线程数量
+    // 缩小线程数时返回调整后的目标值，多余的线程可能还没有退出
     uint32_t get_thread_num() const { return m_thread_num; }
 
+    Mode get_mode() const { return m_mode; }
+
 private:
+    using Node = simple_thread_pool_detail::TaskNode;
+
+    // 工作窃取模式下每个线程的本地队列
+    struct Worker {
+        simple_thread_pool_detail::WorkStealingDeque<Node *> deque;
+    };
+
+    // 某一优先级的排队延迟的计数器
+    struct AtomicQueueStats {
+        std::atomic<std::uint64_t> task_num{0};
+        std::atomic<std::uint64_t> total_wait_ns{0};
+        std::atomic<std::uint64_t> max_wait_ns{0};
+        std::atomic<std::uint64_t> deadline_missed{0};
+    };
+
+    // 当前线程所属的线程池和编号，外部线程的pool为空
+    // 每个线程的遥测计数器(包括各个优先级的排队延迟)
+    // 只由所属的线程写入(几乎没有竞争)，读取时合并
+    // 所有计数器组成只增加的链表，读取时不需要加锁，
+    // 退出的线程留下的计数器由新的线程继续使用
+    // 提交和完成的任务数只增加，用来计算剩余的任务数，
+    // 清零遥测数据时只记录当时的值(base)
+    struct alignas(64) WorkerTelemetry {
+        std::atomic<std::uint64_t> submitted_num{0};
+        std::atomic<std::uint64_t> completed_num{0};
+        std::atomic<std::uint64_t> submitted_base{0};
+        std::atomic<std::uint64_t> completed_base{0};
+        std::atomic<std::uint64_t> pending_high_water{0};
+        simple_thread_pool_detail::AtomicHistogram wait;
+        simple_thread_pool_detail::AtomicHistogram run;
+        std::array<AtomicQueueStats,
+                   simple_thread_pool_detail::PriorityTaskQueue::priority_num>
+            queue;
+        std::atomic<WorkerTelemetry *> next{nullptr};
+    };
+
+    struct WorkerContext {
+        const SimpleThreadPool *pool{nullptr};
+        std::size_t index{0};
+        WorkerTelemetry *telemetry{nullptr};
+    };
+
+    // 退出的线程留下的计数器，由新的线程继续使用
+    // 外部线程退出时线程池可能已经析构，所以单独分配，外部线程只持有weak_ptr
+    struct FreeTelemetry {
+        std::mutex mtx;
+        std::vector<WorkerTelemetry *> blocks;
+    };
+
+    // 外部线程在一个线程池中使用的计数器
+    struct ExternalTelemetry {
+        const SimpleThreadPool *pool{nullptr};
+        std::uint64_t serial{0};  // 区分先后在同一地址构造的线程池
+        WorkerTelemetry *telemetry{nullptr};
+        std::weak_ptr<FreeTelemetry> free_telemetry;
+    };
+
+    // 外部线程退出时把计数器交还给还没有析构的线程池
+    struct ExternalTelemetryList {
+        ExternalTelemetryList() = default;
+        ExternalTelemetryList(const ExternalTelemetryList &) = delete;
+        ExternalTelemetryList &operator=(const ExternalTelemetryList &) =
+            delete;
+
+        ~ExternalTelemetryList() {
+            for (auto &external : items) {
+                if (auto free_telemetry = external.free_telemetry.lock()) {
+                    std::lock_guard<std::mutex> free_guard(
+                        free_telemetry->mtx);
+                    free_telemetry->blocks.push_back(external.telemetry);
+                }
+            }
+        }
+
+        std::vector<ExternalTelemetry> items;
+    };
+
+    // 当前线程的计数器，每个外部线程也有自己的一组
+    WorkerTelemetry &current_telemetry() {
+        const auto &context = current_worker();
+        return (context.pool == this) ? *context.telemetry
+                                      : external_telemetry();
+    }
+
+    // 外部线程第一次提交任务时取一组计数器，之后一直使用
+    WorkerTelemetry &external_telemetry() {
+        auto &items = external_telemetry_list().items;
+        for (const auto &external : items) {
+            if (external.pool == this && external.serial == m_serial) {
+                return *external.telemetry;
+            }
+        }
+
+        // 顺便清理已经析构的线程池
+        items.erase(std::remove_if(items.begin(), items.end(),
+                                   [](const ExternalTelemetry &external) {
+                                       return external.free_telemetry
+                                           .expired();
+                                   }),
+                    items.end());
+        WorkerTelemetry *telemetry = acquire_telemetry();
+        items.push_back(
+            ExternalTelemetry{this, m_serial, telemetry, m_free_telemetry});
+        return *telemetry;
+    }
+
+    void release_telemetry(WorkerTelemetry *telemetry) {
+        std::lock_guard<std::mutex> free_guard(m_free_telemetry->mtx);
+        m_free_telemetry->blocks.push_back(telemetry);
+    }
+
+    static ExternalTelemetryList &external_telemetry_list() {
+        thread_local ExternalTelemetryList the_list;
+        return the_list;
+    }
+
+    static std::uint64_t next_serial() {
+        static std::atomic<std::uint64_t> serial{0};
+        return ++serial;
+    }
+
+    static WorkerContext &current_worker() {
+        thread_local WorkerContext the_context;
+        return the_context;
+    }
+
+    // 空闲的线程是怎样拿到任务的
+    enum class Wakeup : std::uint8_t {
+        NONE,  // 上一个任务结束后直接拿到，不统计
+        SPIN,  // 自旋期间拿到
+        PARK,  // 睡眠后被唤醒拿到
+    };
+
+    // 唤醒延迟的计数器，自旋和睡眠各占一个缓存行
+    struct alignas(64) AtomicWakeupStats {
+        std::atomic<std::uint64_t> num{0};
+        std::atomic<std::uint64_t> total_ns{0};
+        std::atomic<std::uint64_t> max_ns{0};
+    };
+
+    static void update_max(std::atomic<std::uint64_t> &max_value,
+                           std::uint64_t value) {
+        std::uint64_t current = max_value.load(std::memory_order_relaxed);
+        while (value > current
+               && !max_value.compare_exchange_weak(current, value,
+                                                   std::memory_order_relaxed)) {}
+    }
+
+    // future的共享状态从内存池分配
+    template <typename RetType>
+    static std::promise<RetType> make_promise() {
+        return std::promise<RetType>{
+            std::allocator_arg,
+            simple_thread_pool_detail::PoolAllocator<std::byte>{}};
+    }
+
+    // 对参数进行完美转发，使用lambda表达式打包可调用对象、参数和promise
+    // 任务没有执行就被丢弃时，promise析构，future得到broken_promise
+    template <typename RetType, typename F, typename... Args>
+    static auto make_promise_task(std::promise<RetType> promise, F &&f,
+                                  Args &&...args) {
+        return [promise = std::move(promise), func = std::forward<F>(f),
+                ... args = std::forward<Args>(args)]() mutable {
+            try {
+                if constexpr (std::is_void_v<RetType>) {
+                    func(std::forward<Args>(args)...);
+                    promise.set_value();
+                }
+                else {
+                    promise.set_value(func(std::forward<Args>(args)...));
+                }
+            }
+            catch (...) {
+                promise.set_exception(std::current_exception());
+            }
+        };
+    }
+
+    // 批量提交时，右值区间中的元素被移动，否则复制
+    template <typename R, typename T>
+    static std::ranges::range_value_t<R> take_element(T &element) {
+        if constexpr (std::is_lvalue_reference_v<R>) { return element; }
+        else { return std::move(element); }
+    }
+
+    template <typename F>
+    static Node *make_node(const TaskOptions &options, F &&func) {
+        Node *node = Node::create(std::forward<F>(func));
+        node->priority = static_cast<std::uint8_t>(options.priority);
+        if (options.deadline) {
+            node->has_deadline = true;
+            node->deadline = *options.deadline;
+        }
+        return node;
+    }
+
+    // 没有指定优先级和截止时间的任务
+    static bool is_plain(const Node &task) {
+        return task.priority == static_cast<std::uint8_t>(Priority::NORMAL)
+               && !task.has_deadline;
+    }
+
+    static std::uint64_t elapsed_ns(Clock::time_point begin,
+                                    Clock::time_point end) {
+        if (end <= begin) { return 0; }
+        return static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin)
+                .count());
+    }
+
+    // 统计排队延迟，然后执行并释放任务，返回任务结束的时间
+    // wakeup表示执行线程在拿到这个任务之前是否处于空闲
+    // 连续执行任务时用上一个任务的结束时间作为start，每个任务只读一次时钟
+    // 所有计数器都属于当前线程
+    Clock::time_point run_task(Node *task, Wakeup wakeup,
+                               Clock::time_point start) {
+        const auto wait = elapsed_ns(task->enqueue_time, start);
+
+        WorkerTelemetry &telemetry = current_telemetry();
+        auto &stats = telemetry.queue[task->priority];
+        stats.task_num.fetch_add(1, std::memory_order_relaxed);
+        stats.total_wait_ns.fetch_add(wait, std::memory_order_relaxed);
+        update_max(stats.max_wait_ns, wait);
+        if (task->has_deadline && start > task->deadline) {
+            stats.deadline_missed.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (wakeup != Wakeup::NONE) {
+            auto &wakeup_stats =
+                m_wakeup_stats[(wakeup == Wakeup::SPIN) ? 0 : 1];
+            wakeup_stats.num.fetch_add(1, std::memory_order_relaxed);
+            wakeup_stats.total_ns.fetch_add(wait, std::memory_order_relaxed);
+            update_max(wakeup_stats.max_ns, wait);
+        }
+
+        telemetry.wait.record(wait);
+
+        const bool is_worker = (current_worker().pool == this);
+        task->task();
+        if (is_worker && current_worker().pool != this) {
+            // 线程池已经在任务中析构，不能再访问任何成员
+            Node::destroy(task);
+            return Clock::time_point{};
+        }
+        const auto end = Clock::now();
+        telemetry.run.record(elapsed_ns(start, end));
+        Node::destroy(task);
+        finish_task(telemetry);
+        return end;
+    }
+
     // 开启线程池
     void start() {
-        std::unique_lock<std::mutex> mtx_guard(m_mtx);
+        std::lock_guard<std::mutex> control_guard(m_control_mtx);
 
         m_running.store(true);
-        m_idle_thread_num.store(m_thread_num);
+        m_accepting.store(true);
+
+        if (m_mode == Mode::WORK_STEALING) {
+            // 本地队列的位置在运行期间不变，窃取时不需要加锁
+            // 只预留位置，用到时才创建队列
+            m_workers.resize(
+                std::max(m_thread_num.load(), max_stealing_thread_num));
+        }
 
         for (uint32_t i = 0; i < m_thread_num; ++i) {
             // 向线程池中填充默认任务
-            m_pool.emplace_back([this]() {        // 必须显式捕获this指针
-                while (this->m_running.load()) {  // 线程池开启时无法跳出循环
-                    std::packaged_task<void()> task;
-
-                    {
-                        // 获取互斥锁
-                        std::unique_lock<std::mutex> mtx_guard2(m_mtx);
-
-                        // 通过条件变量让线程陷入等待
-                        // 只有当前的任务队列非空或线程池已经被关闭时才会被成功唤醒
-                        this->m_cv.wait(mtx_guard2, [this] {
-                            return !this->m_running.load()
-                                   || !this->m_tasks.empty();
-                        });
-
-                        // 如果任务队列为空，代表没有有效任务，直接return
-                        // 此时通常意味着线程池被关闭，可以跳出while循环
-                        if (this->m_tasks.empty()) { return; }
-
-                        // 以move方式获取队列中的首位任务并执行
-                        task = std::move(this->m_tasks.front());
-                        this->m_tasks.pop();
-                    }
+            spawn_worker();
+        }
+    }
+
+    // 创建一个线程，调用时持有m_control_mtx
+    void spawn_worker() {
+        std::size_t index = 0;
+        if (m_mode == Mode::WORK_STEALING) {
+            // 优先使用已经退出的线程留下的本地队列
+            std::lock_guard<std::mutex> mtx_guard(m_mtx);
+            if (!m_free_workers.empty()) {
+                index = m_free_workers.back();
+                m_free_workers.pop_back();
+            }
+            else {
+                index = m_worker_num.load(std::memory_order_relaxed);
+                if (index >= m_workers.size())
+                    throw std::runtime_error("ThreadPool: too many threads.");
+                m_workers[index] = std::make_unique<Worker>();
+                m_worker_num.store(index + 1, std::memory_order_release);
+            }
+        }
 
-                    this->m_idle_thread_num--;  // 可用线程数-1
-                    task();
-                    this->m_idle_thread_num++;  // 可用线程数+1
+        WorkerTelemetry *telemetry = acquire_telemetry();
+
+        m_idle_thread_num++;
+        try {
+            m_pool.emplace_back([this, index, telemetry] {
+                current_worker() = WorkerContext{this, index, telemetry};
+                if (m_mode == Mode::WORK_STEALING) {
+                    run_stealing_worker(index);
+                }
+                else {
+                    run_shared_worker();
                 }
             });
         }
+        catch (...) {
+            m_idle_thread_num--;
+            std::lock_guard<std::mutex> mtx_guard(m_mtx);
+            if (m_mode == Mode::WORK_STEALING) {
+                m_free_workers.push_back(index);
+            }
+            release_telemetry(telemetry);
+            throw;
+        }
+
+        if (!m_affinity.empty()) {
+            simple_thread_pool_detail::set_thread_affinity(
+                m_pool.back(),
+                m_affinity[(m_pool.size() - 1) % m_affinity.size()]);
+        }
+    }
+
+    // 为新的线程取一组计数器，优先使用已经退出的线程留下的
+    // 可以由任意线程调用
+    WorkerTelemetry *acquire_telemetry() {
+        std::lock_guard<std::mutex> free_guard(m_free_telemetry->mtx);
+        auto &blocks = m_free_telemetry->blocks;
+        if (!blocks.empty()) {
+            WorkerTelemetry *telemetry = blocks.back();
+            blocks.pop_back();
+            return telemetry;
+        }
+
+        m_telemetry.push_back(std::make_unique<WorkerTelemetry>());
+        WorkerTelemetry *telemetry = m_telemetry.back().get();
+        // 加入链表，读取的线程从m_telemetry_head开始遍历
+        telemetry->next.store(
+            m_telemetry_head.next.load(std::memory_order_relaxed),
+            std::memory_order_relaxed);
+        m_telemetry_head.next.store(telemetry, std::memory_order_release);
+        return telemetry;
+    }
+
+    // 线程因为缩容退出时登记自己，由之后调整线程数或关闭线程池的线程回收
+    // 工作窃取模式下把本地队列中剩余的任务转移到全局队列，并交还本地队列
+    void exit_worker(std::size_t index) {
+        if (m_mode == Mode::WORK_STEALING) {
+            simple_thread_pool_detail::TaskList tasks;
+            std::size_t task_num = 0;
+            while (auto task = m_workers[index]->deque.pop()) {
+                tasks.push_back(*task);
+                ++task_num;
+            }
+            if (task_num > 0) {
+                inject_tasks(tasks, task_num);
+                wake_sleeping(task_num);
+            }
+        }
+
+        m_idle_thread_num--;
+        release_telemetry(current_worker().telemetry);
+        std::lock_guard<std::mutex> mtx_guard(m_mtx);
+        m_exited_threads.push_back(std::this_thread::get_id());
+        if (m_mode == Mode::WORK_STEALING) { m_free_workers.push_back(index); }
+    }
+
+    // 合并已经退出的线程，调用时持有m_control_mtx
+    void join_exited_threads() {
+        std::vector<std::thread::id> exited;
+        {
+            std::lock_guard<std::mutex> mtx_guard(m_mtx);
+            exited.swap(m_exited_threads);
+        }
+
+        for (std::thread::id id : exited) {
+            auto it = std::find_if(
+                m_pool.begin(), m_pool.end(),
+                [id](const std::thread &td) { return td.get_id() == id; });
+            if (it != m_pool.end()) {
+                it->join();
+                m_pool.erase(it);
+            }
+        }
+    }
+
+    // 领取一个退出的名额，成功时当前线程应当退出
+    bool try_retire() {
+        uint32_t retire_num = m_retire_num.load(std::memory_order_relaxed);
+        while (retire_num > 0) {
+            if (m_retire_num.compare_exchange_weak(retire_num,
+                                                   retire_num - 1)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // 弹性伸缩: 空闲超时的线程退出，线程数不少于下限
+    // 只尝试加锁，正在调整线程数或关闭时放弃
+    bool try_shrink() {
+        std::unique_lock<std::mutex> control_guard(m_control_mtx,
+                                                   std::try_to_lock);
+        if (!control_guard.owns_lock() || !m_elastic.load()
+            || !m_running.load()) {
+            return false;
+        }
+
+        const uint32_t thread_num = m_thread_num.load();
+        if (thread_num <= m_min_thread_num.load()) { return false; }
+        m_thread_num.store(thread_num - 1);
+        return true;
+    }
+
+    // 弹性伸缩: 所有线程都在执行任务时增加一个线程
+    // 只尝试加锁，不阻塞提交任务的线程；创建线程失败时由已有的线程继续执行
+    void try_grow() {
+        std::unique_lock<std::mutex> control_guard(m_control_mtx,
+                                                   std::try_to_lock);
+        if (!control_guard.owns_lock() || !m_elastic.load()
+            || !m_running.load() || m_retire_num.load() > 0) {
+            return;
+        }
+
+        const uint32_t thread_num = m_thread_num.load();
+        if (thread_num >= m_max_thread_num.load()) { return; }
+        if (m_mode == Mode::WORK_STEALING && thread_num >= m_workers.size()) {
+            return;
+        }
+
+        join_exited_threads();
+        try {
+            spawn_worker();
+        }
+        catch (const std::system_error &) {
+            return;
+        }
+        m_thread_num.store(thread_num + 1);
+    }
+
+    std::chrono::milliseconds idle_timeout() const {
+        return std::chrono::milliseconds{
+            m_idle_timeout_ms.load(std::memory_order_relaxed)};
+    }
+
+    void run_shared_worker() {
+        Clock::time_point last_end{};  // 上一个任务的结束时间，空闲后失效
+        while (m_running.load()) {  // 线程池开启时无法跳出循环
+            // 缩容时多余的线程在两个任务之间退出
+            if (try_retire()) {
+                exit_worker(0);
+                return;
+            }
+
+            Node *task = nullptr;
+            Wakeup wakeup = Wakeup::NONE;
+            bool timed_out = false;
+
+            {
+                // 获取互斥锁
+                std::unique_lock<std::mutex> mtx_guard(m_mtx);
+
+                // 队列为空时先按照空闲策略自旋，自旋期间不持有锁
+                if (m_tasks.empty() && m_running.load() && can_spin()) {
+                    mtx_guard.unlock();
+                    spin_wait([this] {
+                        return m_queued_num.load(std::memory_order_relaxed) > 0
+                               || !m_running.load(std::memory_order_relaxed)
+                               || m_retire_num.load(std::memory_order_relaxed)
+                                      > 0;
+                    });
+                    mtx_guard.lock();
+                    wakeup = Wakeup::SPIN;
+                }
+
+                // 通过条件变量让线程陷入等待
+                // 只有当前的任务队列非空、线程池已经被关闭或者需要缩容时
+                // 才会被成功唤醒
+                // 登记睡眠的线程数，提交任务时只唤醒正在睡眠的线程
+                if (m_tasks.empty() && m_running.load()
+                    && m_retire_num.load() == 0) {
+                    auto ready = [this] {
+                        return !m_running.load() || !m_tasks.empty()
+                               || m_retire_num.load() > 0;
+                    };
+                    m_sleeping_num.fetch_add(1, std::memory_order_relaxed);
+                    if (m_elastic.load()) {
+                        timed_out =
+                            !m_cv.wait_for(mtx_guard, idle_timeout(), ready);
+                    }
+                    else {
+                        m_cv.wait(mtx_guard, ready);
+                    }
+                    m_sleeping_num.fetch_sub(1, std::memory_order_relaxed);
+                    wakeup = Wakeup::PARK;
+                }
+
+                // 取出优先级最高的任务
+                // 队列为空时回到循环开始，检查线程池是否被关闭或者需要退出
+                if (!m_tasks.empty()) {
+                    task = m_tasks.pop();
+                    m_queued_num.store(m_tasks.size(),
+                                       std::memory_order_relaxed);
+                }
+            }
+
+            if (task == nullptr) {
+                last_end = Clock::time_point{};
+                // 弹性伸缩模式下空闲超时的线程退出
+                if (timed_out && try_shrink()) {
+                    exit_worker(0);
+                    return;
+                }
+                continue;
+            }
+
+            const auto start = (wakeup == Wakeup::NONE
+                                && last_end != Clock::time_point{})
+                                   ? last_end
+                                   : Clock::now();
+            m_idle_thread_num--;  // 可用线程数-1
+            last_end = run_task(task, wakeup, start);
+            if (current_worker().pool != this) { return; }  // 已经析构
+            m_idle_thread_num++;  // 可用线程数+1
+        }
+    }
+
+    bool can_spin() const {
+        return m_spin_ns.load(std::memory_order_relaxed) > 0
+               || m_yield_ns.load(std::memory_order_relaxed) > 0;
+    }
+
+    // 按照空闲策略等待ready()成立，超时返回false
+    // 先忙等spin_time，然后每次检查之间yield，直到yield_time也用完
+    template <typename Pred>
+    bool spin_wait(Pred ready) const {
+        const auto spin_time =
+            std::chrono::nanoseconds{m_spin_ns.load(std::memory_order_relaxed)};
+        const auto total_time =
+            spin_time
+            + std::chrono::nanoseconds{
+                m_yield_ns.load(std::memory_order_relaxed)};
+        const auto begin = Clock::now();
+
+        bool yielding = false;
+        for (std::uint32_t i = 0;; ++i) {
+            if (ready()) { return true; }
+
+            // 忙等阶段每隔一段时间才读一次时钟
+            if (yielding || i % 64 == 0) {
+                const auto elapsed = Clock::now() - begin;
+                if (elapsed >= total_time) { return false; }
+                yielding = (elapsed >= spin_time);
+            }
+
+            if (yielding) { std::this_thread::yield(); }
+            else { simple_thread_pool_detail::cpu_relax(); }
+        }
     }
 
-    // 关闭线程池
-    void stop() {
-        m_running.store(false);  // 设置为停止状态
-        m_cv.notify_all();       // 唤醒所有线程
+    // 在线程池自己的任务中析构
+    // 当前线程不再属于这个线程池，任务返回以后直接结束，不再访问成员
+    void destroy_in_worker() {
+        current_worker() = WorkerContext{};
+        std::lock_guard<std::mutex> control_guard(m_control_mtx);
+        m_accepting.store(false);
+        stop();
+    }
+
+    // 停止并合并所有线程，然后丢弃剩余的任务，调用时持有m_control_mtx
+    // 尚未开始执行的任务对应的future得到broken_promise，返回丢弃的任务数
+    // 重复调用没有效果
+    std::size_t stop() {
+        {
+            // 与准备睡眠的线程互斥，避免错过唤醒
+            std::lock_guard<std::mutex> mtx_guard(m_mtx);
+            m_running.store(false);  // 设置为停止状态
+        }
+        m_cv.notify_all();  // 唤醒所有线程
 
-        // 合并所有线程
+        // 合并所有线程，在任务中析构时分离当前线程
         for (auto &td : m_pool) {
-            if (td.joinable()) { td.join(); }
+            if (td.get_id() == std::this_thread::get_id()) { td.detach(); }
+            else if (td.joinable()) { td.join(); }
+        }
+        m_pool.clear();
+        {
+            std::lock_guard<std::mutex> mtx_guard(m_mtx);
+            m_exited_threads.clear();
+        }
+        m_thread_num.store(0);
+        m_retire_num.store(0);
+
+        // 释放剩余的任务
+        std::size_t discarded_num = 0;
+        while (Node *task = m_tasks.pop()) {
+            Node::destroy(task);
+            ++discarded_num;
+        }
+        for (auto &worker : m_workers) {
+            if (!worker) { continue; }
+            while (auto task = worker->deque.pop()) {
+                Node::destroy(*task);
+                ++discarded_num;
+            }
+        }
+        while (Node *task = m_injected.pop()) {
+            Node::destroy(task);
+            ++discarded_num;
+        }
+        m_queued_num.store(0);
+        m_injected_num.store(0);
+        m_injected_urgent_num.store(0);
+        m_injected_deadline.store(no_deadline);
+        m_discarded_num.fetch_add(discarded_num);
+        return discarded_num;
+    }
+
+    // 外部线程只能在线程池开启时提交任务
+    // 关闭过程中线程池内正在执行的任务仍然可以提交后续任务
+    void check_accepting() const {
+        if (!m_accepting.load() && current_worker().pool != this)
+            throw std::runtime_error("ThreadPool is stopped.");
+    }
+
+    // 一个任务结束，关闭线程池时唤醒drain()检查剩余的任务数
+    // 完成数和m_accepting都按照顺序一致的方式访问，
+    // drain()检查时没有看到这个任务结束，这里就一定看到正在关闭
+    void finish_task(WorkerTelemetry &telemetry) {
+        telemetry.completed_num.fetch_add(1);
+        if (!m_accepting.load()) {
+            std::lock_guard<std::mutex> mtx_guard(m_mtx);
+            m_done_cv.notify_all();
+        }
+    }
+
+    // 提交但还没有结束的任务数
+    // 先读完成数再读提交数，每个读到的完成的任务都已经计入提交数
+    std::uint64_t pending_num() const {
+        std::uint64_t finished_num = m_discarded_num.load();
+        for (const WorkerTelemetry *counters = &m_telemetry_head;
+             counters != nullptr;
+             counters = counters->next.load(std::memory_order_acquire)) {
+            finished_num += counters->completed_num.load();
+        }
+        std::uint64_t submitted_num = 0;
+        for (const WorkerTelemetry *counters = &m_telemetry_head;
+             counters != nullptr;
+             counters = counters->next.load(std::memory_order_acquire)) {
+            submitted_num += counters->submitted_num.load();
+        }
+        return (submitted_num > finished_num) ? submitted_num - finished_num
+                                              : 0;
+    }
+
+    // 正在排队的任务数，工作窃取模式下是一个近似值
+    std::uint64_t queued_num() const {
+        if (m_mode == Mode::SHARED_QUEUE) {
+            return m_queued_num.load(std::memory_order_relaxed);
+        }
+        std::uint64_t num = m_injected_num.load(std::memory_order_relaxed);
+        const std::size_t worker_num =
+            m_worker_num.load(std::memory_order_acquire);
+        for (std::size_t i = 0; i < worker_num; ++i) {
+            num += m_workers[i]->deque.size();
+        }
+        return num;
+    }
+
+    // 提交时记录排队和执行中的任务数的最大值
+    // 排队数只计入这次提交放入的队列，执行中的任务数按照不空闲的线程数估计
+    // 计数器只由当前线程写入，不需要比较交换
+    void record_pending(WorkerTelemetry &telemetry, std::uint64_t queued) {
+        const std::uint32_t thread_num =
+            m_thread_num.load(std::memory_order_relaxed);
+        const std::uint32_t idle_num =
+            m_idle_thread_num.load(std::memory_order_relaxed);
+        const std::uint64_t pending =
+            queued + ((thread_num > idle_num) ? thread_num - idle_num : 0);
+        if (pending
+            > telemetry.pending_high_water.load(std::memory_order_relaxed)) {
+            telemetry.pending_high_water.store(pending,
+                                               std::memory_order_relaxed);
+        }
+    }
+
+    void push_task(Node *task) {
+        simple_thread_pool_detail::TaskList tasks;
+        tasks.push_back(task);
+        push_tasks(tasks, 1);
+    }
+
+    // 一批任务只加一次锁，最多唤醒task_num个线程
+    void push_tasks(simple_thread_pool_detail::TaskList &tasks,
+                    std::size_t task_num) {
+        WorkerTelemetry &telemetry = current_telemetry();
+        telemetry.submitted_num.fetch_add(task_num);
+
+        const auto now = Clock::now();
+        if (m_mode == Mode::WORK_STEALING) {
+            record_pending(telemetry,
+                           push_stealing_tasks(tasks, task_num, now));
+        }
+        else {
+            std::uint32_t sleeping_num = 0;
+            std::size_t queued = 0;
+            {
+                std::lock_guard<std::mutex> mtx_guard(m_mtx);
+                while (Node *task = tasks.pop_front()) {
+                    task->enqueue_time = now;
+                    m_tasks.push(task);
+                }
+                queued = m_tasks.size();
+                m_queued_num.store(queued, std::memory_order_relaxed);
+                sleeping_num = m_sleeping_num.load(std::memory_order_relaxed);
+            }
+            record_pending(telemetry, queued);
+
+            // 唤醒睡眠的线程来执行任务，正在自旋的线程会自己发现新任务
+            if (sleeping_num > 0) {
+                if (task_num >= sleeping_num) { m_cv.notify_all(); }
+                else {
+                    for (std::size_t i = 0; i < task_num; ++i) {
+                        m_cv.notify_one();
+                    }
+                }
+            }
+        }
+
+        // 弹性伸缩: 没有空闲的线程时增加线程
+        if (m_elastic.load(std::memory_order_relaxed)
+            && m_idle_thread_num.load(std::memory_order_relaxed) == 0) {
+            try_grow();
+        }
+    }
+
+    //----------------------------------------------------------------------------//
+    // 工作窃取模式
+
+    // 线程池内的线程提交到自己的本地队列，其它线程提交到全局队列
+    // 指定了优先级或截止时间的任务总是放入全局队列，按优先级取出
+    // 返回放入任务以后这些队列中的任务数
+    std::size_t push_stealing_tasks(simple_thread_pool_detail::TaskList &tasks,
+                                    std::size_t task_num,
+                                    Clock::time_point now) {
+        const auto &context = current_worker();
+        const bool is_worker = (context.pool == this);
+
+        simple_thread_pool_detail::TaskList injected;
+        std::size_t injected_num = 0;
+        while (Node *task = tasks.pop_front()) {
+            task->enqueue_time = now;
+            if (is_worker && is_plain(*task)) {
+                m_workers[context.index]->deque.push(task);
+            }
+            else {
+                injected.push_back(task);
+                ++injected_num;
+            }
+        }
+
+        if (injected_num > 0) { inject_tasks(injected, injected_num); }
+        wake_sleeping(task_num);
+
+        std::size_t queued = m_injected_num.load(std::memory_order_relaxed);
+        if (is_worker) { queued += m_workers[context.index]->deque.size(); }
+        return queued;
+    }
+
+    // 放入全局队列
+    void inject_tasks(simple_thread_pool_detail::TaskList &tasks,
+                      std::size_t task_num) {
+        std::lock_guard<std::mutex> mtx_guard(m_inject_mtx);
+        while (Node *task = tasks.pop_front()) { m_injected.push(task); }
+        m_injected_num.fetch_add(task_num, std::memory_order_relaxed);
+        update_injected_urgent();
+    }
+
+    // 更新全局队列中的紧急任务数和最早的截止时间，调用时持有m_inject_mtx
+    void update_injected_urgent() {
+        m_injected_urgent_num.store(m_injected.high_size(),
+                                    std::memory_order_relaxed);
+        const auto deadline = m_injected.earliest_deadline();
+        m_injected_deadline.store((deadline == Clock::time_point::max())
+                                      ? no_deadline
+                                      : deadline.time_since_epoch().count(),
+                                  std::memory_order_relaxed);
+    }
+
+    // 全局队列中是否有已经超过截止时间的任务
+    // 没有带截止时间的任务时不读取时钟
+    bool injected_overdue() const {
+        const auto deadline =
+            m_injected_deadline.load(std::memory_order_relaxed);
+        return deadline != no_deadline
+               && Clock::now().time_since_epoch().count() >= deadline;
+    }
+
+    // 为新放入的task_num个任务唤醒睡眠的线程
+    void wake_sleeping(std::size_t task_num) {
+        // 与睡眠线程的检查构成Dekker式的同步:
+        // 要么睡眠线程在重新检查时看到这些任务，要么这里看到有线程在睡眠
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const std::uint32_t sleeping_num =
+            m_sleeping_num.load(std::memory_order_relaxed);
+        if (sleeping_num > 0) {
+            { std::lock_guard<std::mutex> mtx_guard(m_mtx); }
+            if (task_num >= sleeping_num) { m_cv.notify_all(); }
+            else {
+                for (std::size_t i = 0; i < task_num; ++i) {
+                    m_cv.notify_one();
+                }
+            }
         }
     }
 
-    std::mutex m_mtx;                        // 互斥锁
-    std::condition_variable m_cv;            // 条件变量
-    std::atomic_bool m_running;              // 线程池是否正在运行
-    std::atomic_uint32_t m_thread_num;       // 线程池大小
-    std::atomic_uint32_t m_idle_thread_num;  // 可用的空闲线程数
+    // 依次尝试全局队列中的紧急任务(最高优先级或者已经超过截止时间)、
+    // 自己的本地队列、全局队列，然后从其它线程窃取
+    // 外部线程的index为m_workers.size()，没有本地队列
+    Node *find_task(std::size_t index) {
+        if (m_injected_urgent_num.load(std::memory_order_relaxed) > 0
+            || injected_overdue()) {
+            if (Node *task = pop_injected(0)) { return task; }
+        }
+
+        const std::size_t worker_num =
+            m_worker_num.load(std::memory_order_acquire);
+        if (index < worker_num) {
+            if (auto task = m_workers[index]->deque.pop()) { return *task; }
+        }
+
+        if (m_injected_num.load(std::memory_order_relaxed) > 0) {
+            if (Node *task = pop_injected(
+                    simple_thread_pool_detail::PriorityTaskQueue::priority_num
+                    - 1)) {
+                return task;
+            }
+        }
+
+        // 从下一个线程开始轮流窃取，避免所有线程都从同一个线程窃取
+        // 已经退出的线程的本地队列为空，窃取时直接跳过
+        for (std::size_t i = 1; i <= worker_num; ++i) {
+            const std::size_t victim = (index + i) % worker_num;
+            if (victim == index) { continue; }
+            if (auto task = m_workers[victim]->deque.steal()) { return *task; }
+        }
+        return nullptr;
+    }
+
+    Node *pop_injected(std::size_t max_priority) {
+        std::lock_guard<std::mutex> mtx_guard(m_inject_mtx);
+        Node *task = m_injected.pop(max_priority);
+        if (task != nullptr) {
+            m_injected_num.fetch_sub(1, std::memory_order_relaxed);
+            update_injected_urgent();
+        }
+        return task;
+    }
+
+    // 近似判断是否还有任务，只用于睡眠之前的重新检查
+    bool has_task() const {
+        if (m_injected_num.load(std::memory_order_relaxed) > 0) { return true; }
+        const std::size_t worker_num =
+            m_worker_num.load(std::memory_order_acquire);
+        for (std::size_t i = 0; i < worker_num; ++i) {
+            if (!m_workers[i]->deque.empty()) { return true; }
+        }
+        return false;
+    }
+
+    void run_stealing_worker(std::size_t index) {
+        Wakeup wakeup = Wakeup::NONE;
+        Clock::time_point last_end{};  // 上一个任务的结束时间，空闲后失效
+        while (m_running.load()) {
+            // 缩容时多余的线程在两个任务之间退出
+            if (try_retire()) {
+                exit_worker(index);
+                return;
+            }
+
+            if (Node *task = find_task(index)) {
+                const auto start = (wakeup == Wakeup::NONE
+                                    && last_end != Clock::time_point{})
+                                       ? last_end
+                                       : Clock::now();
+                m_idle_thread_num--;
+                last_end = run_task(task, wakeup, start);
+                if (current_worker().pool != this) { return; }  // 已经析构
+                m_idle_thread_num++;
+                wakeup = Wakeup::NONE;
+                continue;
+            }
+            last_end = Clock::time_point{};
+
+            // 没有找到任务，每次空闲先按照空闲策略自旋一次
+            if (wakeup == Wakeup::NONE && can_spin()) {
+                wakeup = Wakeup::SPIN;
+                if (spin_wait([this] {
+                        return has_task()
+                               || !m_running.load(std::memory_order_relaxed)
+                               || m_retire_num.load(std::memory_order_relaxed)
+                                      > 0;
+                    })) {
+                    continue;
+                }
+            }
+
+            // 准备睡眠
+            // 先登记睡眠再重新检查，与push_task中的检查顺序相反
+            bool timed_out = false;
+            {
+                std::unique_lock<std::mutex> mtx_guard(m_mtx);
+                m_sleeping_num.fetch_add(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (m_running.load() && !has_task()
+                    && m_retire_num.load() == 0) {
+                    if (m_elastic.load()) {
+                        timed_out = (m_cv.wait_for(mtx_guard, idle_timeout())
+                                     == std::cv_status::timeout);
+                    }
+                    else {
+                        m_cv.wait(mtx_guard);
+                    }
+                    wakeup = Wakeup::PARK;
+                }
+                m_sleeping_num.fetch_sub(1, std::memory_order_relaxed);
+            }
+
+            // 弹性伸缩模式下空闲超时的线程退出
+            if (timed_out && !has_task() && try_shrink()) {
+                exit_worker(index);
+                return;
+            }
+        }
+    }
+
+    //----------------------------------------------------------------------------//
+
+    std::mutex m_mtx;                           // 互斥锁
+    std::condition_variable m_cv;               // 条件变量
+    std::atomic_bool m_running;                 // 线程是否正在运行
+    std::atomic_uint32_t m_thread_num;          // 线程池大小
+    std::atomic_uint32_t m_idle_thread_num{0};  // 可用的空闲线程数
+    std::atomic_uint32_t m_sleeping_num{0};     // 正在条件变量上睡眠的线程数
+    const Mode m_mode;                          // 任务的调度方式
+
+    simple_thread_pool_detail::PriorityTaskQueue m_tasks;  // 任务队列
+    std::vector<std::thread> m_pool;                       // 线程池
+
+    // 空闲策略和唤醒延迟
+    std::atomic<std::int64_t> m_spin_ns{0};
+    std::atomic<std::int64_t> m_yield_ns{0};
+    std::array<AtomicWakeupStats, 2> m_wakeup_stats;  // 自旋、睡眠
+    // 共用队列中的任务数，在m_mtx内修改，自旋的线程不加锁读取
+    std::atomic<std::size_t> m_queued_num{0};
+
+    // 调整线程数和关闭
+    // m_control_mtx串行化调整线程数、设置绑定和关闭线程池，并保护m_pool
+    std::mutex m_control_mtx;
+    std::condition_variable m_done_cv;             // drain()等待任务全部结束
+    std::atomic_bool m_accepting{false};           // 外部线程能否提交任务
+    std::atomic_uint32_t m_retire_num{0};          // 等待退出的线程数
+    // 已经退出还没有合并的线程，由m_mtx保护
+    std::vector<std::thread::id> m_exited_threads;
+    std::vector<std::vector<std::uint32_t>> m_affinity;  // 线程绑定的CPU
+
+    // 遥测，m_telemetry_head是链表的头，不属于任何线程
+    const std::uint64_t m_serial{next_serial()};
+    WorkerTelemetry m_telemetry_head;
+    // 只增加，由m_free_telemetry->mtx保护
+    std::vector<std::unique_ptr<WorkerTelemetry>> m_telemetry;
+    std::shared_ptr<FreeTelemetry> m_free_telemetry{
+        std::make_shared<FreeTelemetry>()};
+    std::atomic<std::uint64_t> m_discarded_num{0};
+    std::atomic<std::uint64_t> m_discarded_base{0};
+    // 清零遥测数据时剩余的任务数，作为最大值的下限
+    std::atomic<std::uint64_t> m_pending_high_water{0};
+
+    // 弹性伸缩
+    std::atomic_bool m_elastic{false};
+    std::atomic_uint32_t m_min_thread_num{1};
+    std::atomic_uint32_t m_max_thread_num{0};
+    std::atomic<std::int64_t> m_idle_timeout_ms{1000};
 
-    std::queue<std::packaged_task<void()>> m_tasks;  // 任务队列
-    std::vector<std::thread> m_pool;                 // 线程池
+    // 工作窃取模式
+    // 每个线程的本地队列，容量在开启时确定，之后不再移动
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::atomic<std::size_t> m_worker_num{0};  // 已经创建的本地队列数
+    // 已经退出的线程留下的本地队列，由m_mtx保护
+    std::vector<std::size_t> m_free_workers;
+    std::mutex m_inject_mtx;  // 保护全局队列
+    // 外部线程提交的任务，以及指定了优先级或截止时间的任务
+    simple_thread_pool_detail::PriorityTaskQueue m_injected;
+    std::atomic<std::size_t> m_injected_num{0};
+    std::atomic<std::size_t> m_injected_urgent_num{0};  // 最高优先级的任务数
+    // 其它优先级中最早的截止时间(Clock的计数)
+    constexpr static Clock::rep no_deadline =
+        std::numeric_limits<Clock::rep>::max();
+    std::atomic<Clock::rep> m_injected_deadline{no_deadline};
 };
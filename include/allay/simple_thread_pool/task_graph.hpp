@@ -0,0 +1,213 @@
+#pragma once
+
+#include "simple_thread_pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <initializer_list>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// 任务依赖图(有向无环图)
+// 每个节点声明自己的前驱，前驱全部结束以后立即提交到线程池，
+// 不需要在各个阶段之间用future.get()阻塞线程
+// 节点的前驱必须是更早添加的节点，因此图中不会有环
+// 同一个图可以反复运行，运行时只重置计数器，不再分配节点
+class TaskGraph {
+public:
+    using NodeId = std::size_t;
+
+    TaskGraph() = default;
+
+    TaskGraph(const TaskGraph &) = delete;
+    TaskGraph &operator=(const TaskGraph &) = delete;
+
+    // 添加一个节点，返回节点的编号
+    // 每次运行图时都会调用一次f，因此f不能依赖只能调用一次的状态
+    template <class F>
+    NodeId add(F &&f, std::initializer_list<NodeId> predecessors = {}) {
+        for (NodeId predecessor : predecessors) {
+            if (predecessor >= m_nodes.size())
+                throw std::out_of_range("TaskGraph: unknown predecessor.");
+        }
+
+        const NodeId id = m_nodes.size();
+        m_nodes.emplace_back(std::forward<F>(f));
+        for (NodeId predecessor : predecessors) { precede(predecessor, id); }
+        return id;
+    }
+
+    // 增加一条依赖: after在before结束以后才开始
+    // before必须先于after添加，因此图中不会有环
+    void precede(NodeId before, NodeId after) {
+        if (after >= m_nodes.size() || before >= after)
+            throw std::out_of_range("TaskGraph: invalid dependency.");
+
+        m_nodes[before].successors.push_back(after);
+        ++m_nodes[after].predecessor_num;
+    }
+
+    std::size_t size() const { return m_nodes.size(); }
+
+    // 运行整个图，等待所有节点结束
+    // 等待时调用线程帮助执行线程池中的任务，因此可以在线程池的任务中调用
+    // 某个节点抛出异常或者提交到线程池失败(线程池已经停止)时，
+    // 尚未开始的节点被跳过，结束以后重新抛出第一个异常
+    // 同一个图不能同时运行多次
+    void run(SimpleThreadPool &pool) {
+        if (m_nodes.empty()) { return; }
+
+        m_pool = &pool;
+        m_failed.store(false, std::memory_order_relaxed);
+        m_error = nullptr;
+        for (auto &node : m_nodes) {
+            node.remaining.store(node.predecessor_num,
+                                 std::memory_order_relaxed);
+        }
+        m_pending.store(m_nodes.size(), std::memory_order_release);
+
+        for (NodeId id = 0; id < m_nodes.size(); ++id) {
+            if (m_nodes[id].predecessor_num == 0) { schedule(id); }
+        }
+
+        auto &depth = help_depth();
+        while (m_pending.load(std::memory_order_acquire) > 0) {
+            // 帮助执行其它任务时限制嵌套的深度，避免调用栈过深
+            if (depth < max_help_depth) {
+                ++depth;
+                const bool helped = pool.run_pending_task();
+                --depth;
+                if (helped) { continue; }
+            }
+
+            std::unique_lock<std::mutex> lock(m_mtx);
+            m_cv.wait_for(lock, wait_interval, [this] {
+                return m_pending.load(std::memory_order_acquire) == 0;
+            });
+        }
+
+        // 最后一个节点在持有m_mtx时减少计数，加锁保证它已经不再访问这个对象
+        std::exception_ptr error;
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            error = std::exchange(m_error, nullptr);
+        }
+        if (error) { std::rethrow_exception(error); }
+    }
+
+private:
+    constexpr static std::chrono::microseconds wait_interval{200};
+    constexpr static int max_help_depth = 8;
+
+    struct Node {
+        template <typename F>
+        explicit Node(F &&f) : task(std::forward<F>(f)) {}
+
+        simple_thread_pool_detail::Task task;
+        std::vector<NodeId> successors;
+        std::size_t predecessor_num{0};
+        std::atomic<std::size_t> remaining{0};  // 本次运行中尚未结束的前驱数
+    };
+
+    static int &help_depth() {
+        thread_local int the_depth = 0;
+        return the_depth;
+    }
+
+    // 提交失败时不抛出异常，而是记录错误并跳过这个节点，
+    // 因此在工作线程中执行的节点不会让异常逃出线程池的任务
+    void schedule(NodeId id) {
+        if (!m_failed.load(std::memory_order_relaxed)) {
+            try {
+                m_pool->post([this, id] { execute(id); });
+                return;
+            }
+            catch (...) {
+                fail(std::current_exception());
+            }
+        }
+        skip(id);
+    }
+
+    // 已经失败时不再提交，直接在当前线程结束这个节点以及随之就绪的后继，
+    // 使m_pending最终归零
+    void skip(NodeId id) {
+        std::vector<NodeId> ready{id};
+        while (!ready.empty()) {
+            const NodeId current = ready.back();
+            ready.pop_back();
+            for (NodeId successor : m_nodes[current].successors) {
+                if (m_nodes[successor].remaining.fetch_sub(
+                        1, std::memory_order_acq_rel)
+                    == 1) {
+                    ready.push_back(successor);
+                }
+            }
+            finish();
+        }
+    }
+
+    void fail(std::exception_ptr error) {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        if (!m_error) { m_error = std::move(error); }
+        m_failed.store(true, std::memory_order_relaxed);
+    }
+
+    // 执行一个节点，然后把前驱全部结束的后继提交到线程池
+    // 第一个就绪的后继直接在当前线程继续执行，省去一次入队和唤醒
+    void execute(NodeId id) {
+        while (true) {
+            Node &node = m_nodes[id];
+            if (!m_failed.load(std::memory_order_relaxed)) {
+                try {
+                    node.task();
+                }
+                catch (...) {
+                    fail(std::current_exception());
+                }
+            }
+
+            bool has_next = false;
+            NodeId next = 0;
+            for (NodeId successor : node.successors) {
+                if (m_nodes[successor].remaining.fetch_sub(
+                        1, std::memory_order_acq_rel)
+                    != 1) {
+                    continue;
+                }
+                if (!has_next) {
+                    has_next = true;
+                    next = successor;
+                }
+                else {
+                    schedule(successor);
+                }
+            }
+
+            finish();
+            if (!has_next) { return; }
+            id = next;
+        }
+    }
+
+    void finish() {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            m_cv.notify_all();
+        }
+    }
+
+    std::deque<Node> m_nodes;  // deque保证添加节点时已有节点的地址不变
+    SimpleThreadPool *m_pool{nullptr};
+    std::atomic<std::size_t> m_pending{0};  // 本次运行中尚未结束的节点数
+    std::atomic_bool m_failed{false};
+    std::mutex m_mtx;
+    std::condition_variable m_cv;
+    std::exception_ptr m_error;
+};
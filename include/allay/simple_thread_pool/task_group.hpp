@@ -0,0 +1,163 @@
+#pragma once
+
+#include "simple_thread_pool.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// 一组任务的结构化等待，不需要为每个任务保存future
+// wait时调用线程不会阻塞，而是先执行这一组中还没有开始的任务(后进先出)，
+// 然后帮助执行线程池中排队的其它任务，
+// 因此线程池内的任务可以创建自己的TaskGroup并等待(递归的分治)，
+// 即使所有线程都在等待也不会死锁，也不会额外创建线程
+// 只有当这一组的任务都已经开始执行时才睡眠，它们一定会在其它线程上结束
+class TaskGroup {
+public:
+    explicit TaskGroup(SimpleThreadPool &pool) : m_pool(pool) {}
+
+    // 析构时等待所有任务结束，任务中的异常被丢弃
+    ~TaskGroup() {
+        try {
+            wait();
+        }
+        catch (...) {  // NOLINT(bugprone-empty-catch)
+        }
+    }
+
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+    TaskGroup(TaskGroup &&) = delete;
+    TaskGroup &operator=(TaskGroup &&) = delete;
+
+    // 提交一个属于这一组的任务
+    // 任务同时登记在这一组和线程池中，谁先领取谁执行
+    template <class F>
+    void run(F &&f) {
+        auto item = std::allocate_shared<Item>(
+            simple_thread_pool_detail::PoolAllocator<Item>{},
+            std::forward<F>(f));
+
+        m_pending.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_items.push_back(item);
+        }
+        // 等待的线程可能正在睡眠，唤醒它来执行新的任务
+        m_cv.notify_one();
+
+        try {
+            m_pool.post([this, item] {
+                if (item->claim()) { execute(*item); }
+            });
+        }
+        catch (...) {
+            // 线程池已经停止，撤销这个任务
+            std::lock_guard<std::mutex> lock(m_mtx);
+            std::erase(m_items, item);
+            m_pending.fetch_sub(1, std::memory_order_relaxed);
+            throw;
+        }
+    }
+
+    // 等待这一组的所有任务结束
+    // 如果有任务抛出异常，在这里重新抛出第一个异常
+    void wait() {
+        auto &depth = help_depth();
+        while (m_pending.load(std::memory_order_acquire) > 0) {
+            if (std::shared_ptr<Item> item = take_item()) {
+                if (item->claim()) { execute(*item); }
+                continue;
+            }
+
+            // 帮助执行其它任务时限制嵌套的深度，避免调用栈过深
+            if (depth < max_help_depth) {
+                ++depth;
+                const bool helped = m_pool.run_pending_task();
+                --depth;
+                if (helped) { continue; }
+            }
+
+            // 剩余的任务正在其它线程中执行，
+            // 睡眠到它们全部结束或者提交了新的任务
+            std::unique_lock<std::mutex> lock(m_mtx);
+            m_cv.wait(lock, [this] {
+                return m_pending.load(std::memory_order_acquire) == 0
+                       || !m_items.empty();
+            });
+        }
+
+        // 最后一个任务在持有m_mtx时减少计数，加锁保证它已经不再访问这个对象
+        std::exception_ptr error;
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_items.clear();
+            error = std::exchange(m_error, nullptr);
+        }
+        if (error) { std::rethrow_exception(error); }
+    }
+
+    // 尚未结束的任务数
+    std::size_t get_pending_num() const {
+        return m_pending.load(std::memory_order_relaxed);
+    }
+
+private:
+    constexpr static int max_help_depth = 8;
+
+    // 一个任务，由线程池中的包装任务和等待的线程共享，只有先领取的一方执行
+    struct Item {
+        template <typename F>
+        explicit Item(F &&f) : task(std::forward<F>(f)) {}
+
+        bool claim() {
+            return !claimed.exchange(true, std::memory_order_acq_rel);
+        }
+
+        simple_thread_pool_detail::Task task;
+        std::atomic_bool claimed{false};
+    };
+
+    static int &help_depth() {
+        thread_local int the_depth = 0;
+        return the_depth;
+    }
+
+    // 取出最后提交的任务，已经被线程池领取的直接丢弃
+    std::shared_ptr<Item> take_item() {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        while (!m_items.empty()) {
+            std::shared_ptr<Item> item = std::move(m_items.back());
+            m_items.pop_back();
+            if (!item->claimed.load(std::memory_order_relaxed)) { return item; }
+        }
+        return nullptr;
+    }
+
+    void execute(Item &item) {
+        try {
+            item.task();
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            if (!m_error) { m_error = std::current_exception(); }
+        }
+
+        std::lock_guard<std::mutex> lock(m_mtx);
+        if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            m_cv.notify_all();
+        }
+    }
+
+    SimpleThreadPool &m_pool;
+    std::atomic<std::size_t> m_pending{0};
+    std::mutex m_mtx;
+    std::condition_variable m_cv;
+    std::vector<std::shared_ptr<Item>> m_items;  // 可能还没有开始的任务
+    std::exception_ptr m_error;
+};
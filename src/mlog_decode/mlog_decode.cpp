@@ -0,0 +1,50 @@
+#include "allay/mlog/mlogbinary.hpp"
+#include "allay/mlog/mlogring.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// 把MLogger::link_file_binary写出的二进制日志，
+// 或者MLogger::link_file_ring写出的环形日志还原为文本日志
+// 用法: mlog_decode input [output]，省略output时输出到标准输出
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 3) {
+        std::cerr << "Usage: " << argv[0] << " input [output]\n";
+        return 1;
+    }
+
+    std::ifstream fin(argv[1], std::ios_base::binary);
+    if (!fin) {
+        std::cerr << "Can not open file \"" << argv[1] << "\".\n";
+        return 1;
+    }
+
+    std::ofstream fout;
+    if (argc == 3) {
+        fout.open(argv[2]);
+        if (!fout) {
+            std::cerr << "Can not open file \"" << argv[2] << "\".\n";
+            return 1;
+        }
+    }
+    std::ostream &out = (argc == 3) ? fout : std::cout;
+
+    // 根据文件开头的magic区分两种格式
+    char magic[sizeof(MLogRing::magic)]{};
+    fin.read(static_cast<char *>(magic), sizeof(magic));
+    fin.clear();
+    fin.seekg(0);
+    const bool ring = std::memcmp(static_cast<char *>(magic),
+                                  static_cast<const char *>(MLogRing::magic),
+                                  sizeof(magic))
+                      == 0;
+
+    if (!(ring ? MLogRingReader::decode(fin, out)
+               : MLogBinaryReader::decode(fin, out))) {
+        std::cerr << "Invalid or truncated log file \"" << argv[1] << "\".\n";
+        return 1;
+    }
+
+    return 0;
+}
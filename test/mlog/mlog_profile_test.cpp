@@ -0,0 +1,123 @@
+// 打开日志语句的统计，检查统计的宏展开
+#define MLOG_PROFILE
+#include "allay/mlog/mlog.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <source_location>
+#include <string>
+#include <string_view>
+
+namespace {
+
+bool pass = true;
+
+const std::string log_dir = "mlog_profile_test_output/";
+
+void check(bool cond, const std::string &msg) {
+    if (!cond) {
+        std::cerr << "Check failed: " << msg << "\n";
+        pass = false;
+    }
+}
+
+std::size_t count_lines(const std::string &file_name,
+                        const std::string &pattern) {
+    std::ifstream fin(log_dir + file_name);
+    std::string line;
+    std::size_t count = 0;
+    while (std::getline(fin, line)) {
+        if (line.find(pattern) != std::string::npos) { ++count; }
+    }
+    return count;
+}
+
+// 每一处日志语句分别统计记录数、过滤次数和字节数
+void test_profile() {
+    mlog::create_logger("profile").link_file_trunc("profile.log");
+    mlog::get_logger("profile").set_level(mlog::Level::info);
+
+    const auto line = std::source_location::current().line();
+    for (int i = 0; i < 10; ++i) {
+        MLOG_INFO("profile") << "0123456789\n";  // line + 2
+        MLOG_DEBUG("profile") << "hidden\n";     // line + 3
+    }
+    mlog::set_level_debug();
+    MLOG_DEBUG("profile") << "logger level\n";  // line + 6
+    mlog::set_level_info();
+
+    auto find = [line](std::uint_least32_t offset) {
+        for (const auto &entry : MLogProfiler::get_entries()) {
+            if (entry.location.line() == line + offset
+                && std::string_view{entry.location.file_name()}.ends_with(
+                    "mlog_profile_test.cpp")) {
+                return entry;
+            }
+        }
+        return MLogProfiler::Entry{};
+    };
+
+    const auto info = find(2);
+    check(info.records == 10 && info.filtered == 0, "profile: records");
+    check(info.bytes > 10 * 11, "profile: bytes");
+    check(info.nanoseconds > 0, "profile: time");
+    check(find(3).filtered == 10 && find(3).records == 0,
+          "profile: global filter");
+    check(find(6).filtered == 1 && find(6).records == 0,
+          "profile: logger filter");
+}
+
+int evaluated_count = 0;
+
+int expensive_value() {
+    ++evaluated_count;
+    return evaluated_count;
+}
+
+// 统计的宏展开同样不求值被过滤的参数，也可以与外层的if-else一起使用
+void test_profile_filter() {
+    auto &logger = mlog::create_logger("profile_filter")
+                       .link_file_trunc("profile_filter.log")
+                       .set_level(mlog::Level::warn);
+
+    MLOG_DEBUG("profile_filter") << "debug " << expensive_value() << '\n';
+    MLOG_INFO("profile_filter") << "info " << expensive_value() << '\n';
+    check(evaluated_count == 0, "profile filter: disabled arguments evaluated");
+
+    MLOG_WARN("profile_filter") << "warn " << expensive_value() << '\n';
+    check(evaluated_count == 1, "profile filter: enabled arguments skipped");
+
+    bool flag = false;
+    if (flag)
+        MLOG_ERROR("profile_filter") << "if-branch\n";
+    else
+        MLOG_ERROR("profile_filter") << "else-branch\n";
+
+    logger.flush();
+    check(count_lines("profile_filter.log", "warn 1") == 1,
+          "profile filter: warn");
+    check(count_lines("profile_filter.log", "if-branch") == 0,
+          "profile filter: if-branch");
+    check(count_lines("profile_filter.log", "else-branch") == 1,
+          "profile filter: else-branch");
+}
+
+}  // namespace
+
+int main() {
+    std::filesystem::remove_all(log_dir);
+    mlog::init(log_dir);
+    mlog::set_level_info();
+
+    test_profile();
+    test_profile_filter();
+
+    if (!pass) {
+        std::cout << "MLog profile test failed!\n";
+        return 1;
+    }
+
+    return 0;
+}
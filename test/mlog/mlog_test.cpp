@@ -0,0 +1,735 @@
+#include "allay/mlog/mlog.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+bool pass = true;
+
+const std::string log_dir = "mlog_test_output/";
+
+void check(bool cond, const std::string &msg) {
+    if (!cond) {
+        std::cerr << "Check failed: " << msg << "\n";
+        pass = false;
+    }
+}
+
+std::size_t count_lines(const std::string &file_name,
+                        const std::string &pattern) {
+    std::ifstream fin(log_dir + file_name);
+    std::string line;
+    std::size_t count = 0;
+    while (std::getline(fin, line)) {
+        if (line.find(pattern) != std::string::npos) { ++count; }
+    }
+    return count;
+}
+
+void test_async_block() {
+    auto &logger = mlog::create_logger("async_block")
+                       .link_file_trunc("async_block.log")
+                       .enable_async(64, mlog::Overflow::BLOCK);
+
+    for (int i = 0; i < 5000; ++i) {
+        mlog::info("async_block") << " record " << i << '\n';
+    }
+    logger.flush();
+
+    auto stats = logger.get_async_stats();
+    check(stats.enqueued == 5000, "async block: enqueued");
+    check(stats.written == 5000, "async block: written");
+    check(stats.dropped == 0, "async block: dropped");
+    check(count_lines("async_block.log", " record ") == 5000,
+          "async block: lines in file");
+}
+
+void test_async_drop(const std::string &name, mlog::Overflow overflow) {
+    auto &logger = mlog::create_logger(name)
+                       .link_file_trunc(name + ".log")
+                       .enable_async(16, overflow);
+
+    for (int i = 0; i < 5000; ++i) {
+        mlog::info(name) << " record " << i << '\n';
+    }
+    logger.flush();
+
+    auto stats = logger.get_async_stats();
+    check(stats.written + stats.dropped == 5000, name + ": written + dropped");
+    check(count_lines(name + ".log", " record ") == stats.written,
+          name + ": lines in file");
+}
+
+void test_async_switch() {
+    // 关闭异步前的记录必须全部写出，关闭后恢复同步
+    auto &logger = mlog::create_logger("async_switch")
+                       .link_file_trunc("async_switch.log")
+                       .enable_async();
+
+    mlog::info("async_switch") << " before\n";
+    logger.disable_async();
+    check(!logger.is_async(), "async switch: disabled");
+    mlog::info("async_switch") << " after\n";
+    logger.flush();
+
+    check(count_lines("async_switch.log", " before") == 1,
+          "async switch: before");
+    check(count_lines("async_switch.log", " after") == 1,
+          "async switch: after");
+}
+
+// 每一行都必须是一条完整的记录，不能被其它线程的记录打断
+void test_multi_thread(const std::string &name, bool async_flag) {
+    auto &logger =
+        mlog::create_logger(name).link_file_trunc(name + ".log");
+    if (async_flag) { logger.enable_async(256); }
+
+    constexpr int thread_num = 8;
+    constexpr int record_num = 2000;
+
+    std::vector<std::thread> threads;
+    threads.reserve(thread_num);
+    for (int t = 0; t < thread_num; ++t) {
+        threads.emplace_back([&name, t] {
+            for (int i = 0; i < record_num; ++i) {
+                mlog::info(name) << " thread " << t << " record " << i
+                                 << " end" << '\n';
+            }
+        });
+    }
+    for (auto &td : threads) { td.join(); }
+    logger.flush();
+
+    std::ifstream fin(log_dir + name + ".log");
+    std::string line;
+    std::size_t count = 0;
+    while (std::getline(fin, line)) {
+        if (line.find(" record ") == std::string::npos) { continue; }
+        check(line.starts_with("[INFO]{" + name + "} thread ")
+                  && line.ends_with(" end")
+                  && line.find("[INFO]", 1) == std::string::npos,
+              name + ": broken line \"" + line + "\"");
+        ++count;
+    }
+    check(count == thread_num * record_num, name + ": lines in file");
+}
+
+// 其它线程写记录时切换日志文件，每一行仍然是一条完整的记录
+// 切换的间隙中的记录会输出到cout
+void test_relink(const std::string &name, bool async_flag) {
+    auto &logger =
+        mlog::create_logger(name).link_file_trunc(name + "_0.log");
+    if (async_flag) { logger.enable_async(256); }
+
+    std::atomic_bool stop_flag{false};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&] {
+            while (!stop_flag.load()) {
+                mlog::info(name) << " relink record end\n";
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        });
+    }
+    for (int i = 1; i <= 20; ++i) {
+        logger.link_file_trunc(name + "_" + std::to_string(i % 2) + ".log");
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    stop_flag = true;
+    for (auto &td : threads) { td.join(); }
+    logger.link_none();
+
+    for (int i = 0; i < 2; ++i) {
+        std::ifstream fin(log_dir + name + "_" + std::to_string(i) + ".log");
+        std::string line;
+        while (std::getline(fin, line)) {
+            if (line.find(" relink") == std::string::npos) { continue; }
+            check(line == "[INFO]{" + name + "} relink record end",
+                  name + ": broken line \"" + line + "\"");
+        }
+    }
+}
+
+int nested_value() {
+    mlog::info("nested") << " inner\n";
+    return 42;
+}
+
+// 一条记录的参数中又产生了另一条记录
+void test_nested() {
+    auto &logger =
+        mlog::create_logger("nested").link_file_trunc("nested.log");
+
+    mlog::info("nested") << " outer " << nested_value() << '\n';
+    logger.flush();
+
+    check(count_lines("nested.log", "[INFO]{nested} inner") == 1,
+          "nested: inner");
+    check(count_lines("nested.log", "[INFO]{nested} outer 42") == 1,
+          "nested: outer");
+}
+
+int evaluated_count = 0;
+
+int expensive_value() {
+    ++evaluated_count;
+    return evaluated_count;
+}
+
+// 日志等级不满足时，宏后面的参数不会被求值
+void test_level_filter() {
+    auto &logger = mlog::create_logger("level_filter")
+                       .link_file_trunc("level_filter.log");
+
+    mlog::set_level_warn();
+    MLOG_DEBUG("level_filter") << "debug " << expensive_value() << '\n';
+    MLOG_INFO("level_filter") << "info " << expensive_value() << '\n';
+    check(evaluated_count == 0, "level filter: disabled arguments evaluated");
+
+    MLOG_WARN("level_filter") << "warn " << expensive_value() << '\n';
+    MLOG_ERROR("level_filter") << "error " << expensive_value() << '\n';
+    check(evaluated_count == 2, "level filter: enabled arguments skipped");
+
+    // 与外层的if-else一起使用
+    bool flag = false;
+    if (flag)
+        MLOG_ERROR("level_filter") << "if-branch\n";
+    else
+        MLOG_ERROR("level_filter") << "else-branch\n";
+
+    mlog::set_level_info();
+    logger.flush();
+
+    check(count_lines("level_filter.log", "debug ") == 0, "level filter: debug");
+    check(count_lines("level_filter.log", "info ") == 0, "level filter: info");
+    check(count_lines("level_filter.log", "warn 1") == 1, "level filter: warn");
+    check(count_lines("level_filter.log", "error 2") == 1,
+          "level filter: error");
+    check(count_lines("level_filter.log", "if-branch") == 0,
+          "level filter: if-branch");
+    check(count_lines("level_filter.log", "else-branch") == 1,
+          "level filter: else-branch");
+    check(count_lines("level_filter.log", "mlog_test.cpp") == 3,
+          "level filter: source stamp");
+    check(count_lines("level_filter.log", " test_level_filter ") == 3,
+          "level filter: function name");
+}
+
+// 每个logger可以单独设置等级，句柄和名称两种方式的效果一致
+void test_logger_level() {
+    MLogHandle quiet = mlog::create_logger("logger_level")
+                           .link_file_trunc("logger_level.log")
+                           .set_level(mlog::Level::warn);
+    evaluated_count = 0;
+
+    // 按名称时logger的等级在查找之后、参数求值之前判断
+    MLOG_INFO("logger_level") << "name info " << expensive_value() << '\n';
+    MLOG_INFO(quiet) << "handle info " << expensive_value() << '\n';
+    quiet.info_fmt("fmt info {}", 1);
+    check(evaluated_count == 0, "logger level: disabled arguments evaluated");
+
+    MLOG_WARN("logger_level") << "name warn\n";
+    MLOG_WARN(quiet) << "handle warn\n";
+    quiet.error() << "handle error\n";
+    quiet.warn_fmt("fmt warn {}", 2);
+
+    // 宏的参数只求值一次
+    int resolved_num = 0;
+    auto resolve = [&resolved_num, quiet] {
+        ++resolved_num;
+        return quiet;
+    };
+    MLOG_WARN(resolve()) << "resolved once\n";
+    MLOG_INFO(resolve()) << "resolved filtered\n";
+    check(resolved_num == 2, "logger level: arguments evaluated twice");
+
+    // 全局等级更严格时同样生效
+    mlog::set_level_error();
+    MLOG_WARN(quiet) << "global filtered\n";
+    mlog::set_level_info();
+
+    quiet->flush();
+    check(count_lines("logger_level.log", "name info") == 0,
+          "logger level: name info");
+    check(count_lines("logger_level.log", "handle info") == 0,
+          "logger level: handle info");
+    check(count_lines("logger_level.log", "fmt info") == 0,
+          "logger level: fmt info");
+    check(count_lines("logger_level.log", "name warn") == 1,
+          "logger level: name warn");
+    check(count_lines("logger_level.log", "handle warn") == 1,
+          "logger level: handle warn");
+    check(count_lines("logger_level.log", "handle error") == 1,
+          "logger level: handle error");
+    check(count_lines("logger_level.log", "fmt warn 2") == 1,
+          "logger level: fmt warn");
+    check(count_lines("logger_level.log", "resolved once") == 1,
+          "logger level: resolved once");
+    check(count_lines("logger_level.log", "resolved filtered") == 0,
+          "logger level: resolved filtered");
+    check(count_lines("logger_level.log", "global filtered") == 0,
+          "logger level: global level");
+}
+
+enum class Color { red = 1, green = 2 };
+
+// {}格式化在同步和异步模式下输出一致
+void test_format(const std::string &name, bool async_flag) {
+    auto &logger = mlog::create_logger(name).link_file_trunc(name + ".log");
+    if (async_flag) { logger.enable_async(); }
+
+    const std::string str = "str";
+    logger.info_fmt("int={} double={} bool={} char={}", 42, 0.5, true, 'c');
+    logger.info_fmt("enum={} unsigned={} escape={{}}", Color::green, 7U);
+    logger.info_fmt("string={} literal={} view={}", str, "lit",
+                    std::string_view{"view"});
+    logger.debug_fmt("hidden {}", 1);  // 当前等级是info
+    logger.flush();
+
+    check(count_lines(name + ".log",
+                      "[INFO]{" + name
+                          + "} int=42 double=0.5 bool=true char=c")
+              == 1,
+          name + ": numbers");
+    check(count_lines(name + ".log",
+                      "[INFO]{" + name + "} enum=2 unsigned=7 escape={}")
+              == 1,
+          name + ": enum and escape");
+    check(count_lines(name + ".log",
+                      "[INFO]{" + name + "} string=str literal=lit view=view")
+              == 1,
+          name + ": strings");
+    check(count_lines(name + ".log", "hidden") == 0, name + ": level");
+}
+
+// 二进制日志解码后与文本日志的内容一致
+void test_binary() {
+    auto &logger = mlog::create_logger("binary").link_file_binary("binary.bin");
+    check(logger.is_binary(), "binary: mode");
+
+    const std::string str = "str";
+    for (int i = 0; i < 1000; ++i) {
+        logger.info_fmt("int={} double={} char={}", i, 0.5, 'c');
+    }
+    logger.warn_fmt("enum={} bool={} escape={{}}", Color::red, false);
+    logger.info_fmt("string={} view={}", str, std::string_view{"view"});
+    logger.debug_fmt("hidden {}", 1);  // 当前等级是info
+    mlog::info("binary") << " stream " << 3 << '\n';
+    logger << "raw line\n";
+    logger.link_cout();
+
+    std::ifstream fin(log_dir + "binary.bin", std::ios_base::binary);
+    std::ofstream fout(log_dir + "binary.log");
+    check(MLogBinaryReader::decode(fin, fout), "binary: decode");
+    fout.close();
+
+    check(count_lines("binary.log", "[INFO]{binary} int=") == 1000,
+          "binary: numbers");
+    check(count_lines("binary.log", "[INFO]{binary} int=999 double=0.5 char=c")
+              == 1,
+          "binary: last number");
+    check(count_lines("binary.log",
+                      "[WARN]{binary} enum=1 bool=false escape={}")
+              == 1,
+          "binary: enum and escape");
+    check(count_lines("binary.log", "[INFO]{binary} string=str view=view")
+              == 1,
+          "binary: strings");
+    check(count_lines("binary.log", "[INFO]{binary} stream 3") == 1,
+          "binary: stream record");
+    check(count_lines("binary.log", "raw line") == 1, "binary: raw line");
+    check(count_lines("binary.log", "MLOG START") == 1, "binary: start");
+    check(count_lines("binary.log", "MLOG END") == 1, "binary: end");
+    check(count_lines("binary.log", "hidden") == 0, "binary: level");
+}
+
+// 多线程写日志时轮转，每条记录恰好出现在某一个文件中
+void test_rotation(const std::string &name, bool async_flag) {
+    auto &logger = mlog::create_logger(name)
+                       .link_file_trunc(name + ".log")
+                       .set_rotation(mlog::Rotation{.max_bytes = 4096});
+    if (async_flag) { logger.enable_async(256); }
+
+    constexpr int thread_num = 4;
+    constexpr int record_num = 500;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_num; ++t) {
+        threads.emplace_back([&name, t] {
+            for (int i = 0; i < record_num; ++i) {
+                mlog::info(name) << " record " << t * record_num + i << '\n';
+            }
+        });
+    }
+    for (auto &thread : threads) { thread.join(); }
+    logger.link_cout();
+
+    std::vector<std::string> files{name + ".log"};
+    for (std::size_t i = 1;
+         std::filesystem::exists(log_dir + name + ".log." + std::to_string(i));
+         ++i) {
+        files.push_back(name + ".log." + std::to_string(i));
+    }
+    check(files.size() > 2, name + ": rotated");
+
+    std::vector<int> seen(thread_num * record_num, 0);
+    for (const auto &file : files) {
+        check(count_lines(file, "MLOG START") == 1, name + ": start " + file);
+        check(count_lines(file, "MLOG END") == 1, name + ": end " + file);
+        check(std::filesystem::file_size(log_dir + file) < 4096 + 128,
+              name + ": size " + file);
+
+        std::ifstream fin(log_dir + file);
+        std::string line;
+        while (std::getline(fin, line)) {
+            const auto pos = line.find(" record ");
+            if (pos != std::string::npos) {
+                ++seen.at(std::stoul(line.substr(pos + 8)));
+            }
+        }
+    }
+    for (std::size_t i = 0; i < seen.size(); ++i) {
+        if (seen[i] != 1) {
+            check(false, name + ": record " + std::to_string(i) + " seen "
+                             + std::to_string(seen[i]) + " times");
+            break;
+        }
+    }
+}
+
+// 历史文件无法改名时报告错误，继续追加到当前文件，不能退出进程
+// 异步模式下在后台线程中轮转
+void test_rotation_failed(const std::string &name, bool async_flag) {
+    // 两个历史文件的位置都是非空的目录，改名一定失败
+    for (int i = 1; i <= 2; ++i) {
+        const std::string dir = log_dir + name + ".log." + std::to_string(i);
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir + "/keep");
+    }
+
+    auto &logger = mlog::create_logger(name)
+                       .link_file_trunc(name + ".log")
+                       .set_rotation(mlog::Rotation{.max_bytes = 1024,
+                                                    .max_files = 2});
+    if (async_flag) { logger.enable_async(256); }
+
+    for (int i = 0; i < 200; ++i) {
+        mlog::info(name) << " record " << i << '\n';
+    }
+    logger.link_cout();
+
+    check(count_lines(name + ".log", " record ") == 200,
+          name + ": records kept");
+    check(count_lines(name + ".log", "MLOG START") == 1, name + ": start");
+    for (int i = 1; i <= 2; ++i) {
+        std::filesystem::remove_all(log_dir + name + ".log."
+                                    + std::to_string(i));
+    }
+}
+
+// 只保留最新的若干个历史文件，二进制文件轮转后各自可以解码
+void test_rotation_max_files() {
+    auto &logger = mlog::create_logger("rotation_max")
+                       .link_file_binary("rotation_max.bin")
+                       .set_rotation(mlog::Rotation{.max_bytes = 1024,
+                                                    .max_files = 2});
+
+    for (int i = 0; i < 1000; ++i) { logger.info_fmt("record {}", i); }
+    logger.link_cout();
+
+    const std::string file = log_dir + "rotation_max.bin";
+    check(std::filesystem::exists(file + ".1"), "rotation max: .1");
+    check(std::filesystem::exists(file + ".2"), "rotation max: .2");
+    check(!std::filesystem::exists(file + ".3"), "rotation max: .3");
+
+    std::ifstream fin(file, std::ios_base::binary);
+    std::ofstream fout(log_dir + "rotation_max.log");
+    check(MLogBinaryReader::decode(fin, fout), "rotation max: decode");
+    fout.close();
+    check(count_lines("rotation_max.log", "record 999") == 1,
+          "rotation max: last record");
+}
+
+std::string decode_ring(const std::string &file_name) {
+    std::ifstream fin(log_dir + file_name, std::ios_base::binary);
+    std::ostringstream out;
+    check(MLogRingReader::decode(fin, out), file_name + ": decode");
+    return out.str();
+}
+
+// 环形日志只保留最近的记录，不需要关闭文件就可以读出
+void test_ring() {
+    auto &logger = mlog::create_logger("ring").link_file_ring("ring.ring", 4096);
+
+    for (int i = 0; i < 1000; ++i) {
+        mlog::info("ring") << " record " << i << '\n';
+    }
+
+    const std::string text = decode_ring("ring.ring");
+    check(text.size() <= 4096 && text.size() > 4096 - 64, "ring: size");
+    check(text.find("[INFO]{ring} record 999\n") != std::string::npos,
+          "ring: last record");
+    check(text.find("record 0\n") == std::string::npos, "ring: overwritten");
+    check(text.rfind("[INFO]{ring} record ", 0) == 0, "ring: whole lines");
+
+    logger.link_cout();
+    check(decode_ring("ring.ring").find("MLOG END") != std::string::npos,
+          "ring: end");
+}
+
+#ifndef _WIN32
+// 进程没有执行任何收尾工作就退出，环形日志中的记录仍然可以恢复
+void test_ring_crash() {
+    const pid_t pid = fork();
+    if (pid == 0) {
+        mlog::create_logger("ring_crash").link_file_ring("ring_crash.ring", 4096);
+        for (int i = 0; i < 1000; ++i) {
+            mlog::info("ring_crash") << " record " << i << '\n';
+        }
+        std::_Exit(1);
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    const std::string text = decode_ring("ring_crash.ring");
+    check(text.find("[INFO]{ring_crash} record 999\n") != std::string::npos,
+          "ring crash: last record");
+    check(text.find("MLOG END") == std::string::npos, "ring crash: no end");
+}
+#endif
+
+// 一条记录交给多个sink，每个sink按照自己的等级过滤
+void test_sinks(const std::string &name, bool async_flag) {
+    auto memory = std::make_shared<MLogMemorySink>(4);
+    auto file = std::make_shared<MLogFileSink>(
+        name + ".sink.log", mlog::Rotation{.max_bytes = 2048},
+        std::ios_base::trunc);
+    file->set_level(mlog::Level::warn);
+    int warn_count = 0;
+    auto callback = std::make_shared<MLogCallbackSink>(
+        [&warn_count](mlog::Level level, std::string_view record) {
+            if (level == mlog::Level::warn && record.ends_with('\n')) {
+                ++warn_count;
+            }
+        });
+
+    auto &logger = mlog::create_logger(name)
+                       .link_file_trunc(name + ".log")
+                       .add_sink(memory)
+                       .add_sink(file)
+                       .add_sink(callback);
+    if (async_flag) { logger.enable_async(); }
+
+    for (int i = 0; i < 100; ++i) {
+        MLOG_INFO(name) << "info " << i << '\n';
+        MLOG_WARN(name) << "warn " << i << '\n';
+    }
+    logger.error_fmt("error {}", 100);
+    logger << "raw line\n";
+    logger.flush();
+
+    const auto records = memory->get_records();
+    check(records.size() == 4, "sinks: memory size");
+    check(records.back().find("[ERROR]{" + name + "} error 100\n")
+              != std::string::npos,
+          "sinks: memory last");
+    check(warn_count == 100, "sinks: callback");
+    check(count_lines(name + ".log", "info ") == 100, "sinks: logger file");
+    check(count_lines(name + ".sink.log", "info ") == 0, "sinks: file level");
+    // 每条记录完整地写入某一个文件，文件大小不超过限制
+    std::size_t warn_lines = count_lines(name + ".sink.log", "warn ");
+    for (int i = 1; std::filesystem::exists(log_dir + name + ".sink.log."
+                                            + std::to_string(i));
+         ++i) {
+        const std::string rotated = name + ".sink.log." + std::to_string(i);
+        warn_lines += count_lines(rotated, "warn ");
+        check(std::filesystem::file_size(log_dir + rotated) <= 2048,
+              "sinks: rotated size");
+    }
+    check(warn_lines == 100, "sinks: rotated file");
+    check(count_lines(name + ".sink.log", "raw line") == 0,
+          "sinks: raw line");
+}
+
+#ifndef _WIN32
+// 带缓冲的控制台sink按块写出，输出不是终端时去掉颜色
+void test_buffered_console() {
+    const std::string file_name = log_dir + "buffered_console.log";
+    const int fd = ::open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    check(fd >= 0, "buffered console: open");
+    auto console = std::make_shared<MLogBufferedConsoleSink>(
+        4096, std::chrono::milliseconds{0}, fd);
+
+    auto &logger = mlog::create_logger("buffered_console")
+                       .link_none()
+                       .set_format(mlog::Format::LEVEL_COLOR)
+                       .add_sink(console);
+    for (int i = 0; i < 1000; ++i) {
+        MLOG_INFO("buffered_console") << "record " << i << '\n';
+    }
+    logger.flush();
+    ::close(fd);
+
+    check(count_lines("buffered_console.log", "[INFO]") == 1000,
+          "buffered console: records");
+    check(count_lines("buffered_console.log", "\x1b") == 0,
+          "buffered console: color");
+    // 每条记录大约100字节，4KB一块
+    check(console->get_write_count() < 100, "buffered console: writes");
+}
+#endif
+
+// 多线程同时经过同一处MLOG_IF_XXX宏时，计数准确
+// 只有sink时，所有sink都不接受的记录不会被格式化
+void test_sink_level(const std::string &name, bool async_flag) {
+    auto memory = std::make_shared<MLogMemorySink>(8);
+    memory->set_level(mlog::Level::warn);
+    auto &logger = mlog::create_logger(name).link_none().add_sink(memory);
+    if (async_flag) { logger.enable_async(); }
+
+    evaluated_count = 0;
+    MLOG_INFO(name) << "info " << expensive_value() << '\n';
+    check(evaluated_count == 0, "sink level: disabled arguments evaluated");
+    MLOG_WARN(name) << "warn " << expensive_value() << '\n';
+    check(evaluated_count == 1, "sink level: enabled arguments skipped");
+
+    memory->set_level(mlog::Level::error);
+    MLOG_WARN(name) << "warn " << expensive_value() << '\n';
+    check(evaluated_count == 1, "sink level: level change ignored");
+    memory->set_level(mlog::Level::info);
+    MLOG_INFO(name) << "info " << expensive_value() << '\n';
+    check(evaluated_count == 2, "sink level: level change ignored");
+    logger.flush();
+
+    check(memory->get_records().size() == 2, "sink level: memory size");
+    if (async_flag) {
+        check(logger.get_async_stats().written == 2,
+              "sink level: async written");
+    }
+    logger.clear_sinks();
+}
+
+void test_sampling() {
+    constexpr int thread_num = 8;
+    constexpr int loop_num = 10000;
+    std::atomic<int> first{0};
+    std::atomic<int> every{0};
+    std::atomic<int> more{0};
+    std::atomic<int> every_ms{0};
+    std::atomic<int> limited{0};
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_num; ++t) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < loop_num; ++i) {
+                MLOG_IF_FIRST_N(10) { ++first; }
+                MLOG_IF_EVERY_N(100) { ++every; }
+                MLOG_IF_MORETHAN_N(1000) { ++more; }
+                MLOG_IF_EVERY_MS(1000) { ++every_ms; }
+                MLOG_RATE_LIMIT(50) { ++limited; }
+            }
+        });
+    }
+    for (auto &thread : threads) { thread.join(); }
+
+    check(first == 10, "sampling: first n");
+    check(every == thread_num * loop_num / 100, "sampling: every n");
+    check(more == thread_num * loop_num - 1000, "sampling: more than n");
+    // 依赖实际的耗时，只检查上界
+    check(every_ms > 0 && every_ms <= 2, "sampling: every ms");
+    check(limited > 0 && limited <= 60, "sampling: rate limit");
+}
+
+// 按时间控制的计数使用给定的时间，结果是确定的
+void test_sampling_clock() {
+    using Duration = std::chrono::steady_clock::duration;
+    auto ticks = [](std::chrono::milliseconds ms) {
+        return std::chrono::duration_cast<Duration>(ms).count();
+    };
+    const std::int64_t start = ticks(std::chrono::milliseconds{1000000});
+
+    MLogTool::EveryMs every_ms{100};
+    int passed = 0;
+    for (int ms = 0; ms < 1000; ++ms) {
+        if (every_ms.judge(start + ticks(std::chrono::milliseconds{ms}))) {
+            ++passed;
+        }
+    }
+    check(passed == 10, "sampling clock: every ms");
+
+    // 开始时允许突发per_sec次，之后每个间隔补充一个
+    MLogTool::RateLimit limit{50};
+    passed = 0;
+    for (int i = 0; i < 100; ++i) { passed += limit.judge(start) ? 1 : 0; }
+    check(passed == 50, "sampling clock: burst");
+    for (int ms = 1; ms <= 1000; ++ms) {
+        if (limit.judge(start + ticks(std::chrono::milliseconds{ms}))) {
+            ++passed;
+        }
+    }
+    check(passed == 100, "sampling clock: rate");
+}
+
+}  // namespace
+
+int main() {
+    std::filesystem::remove_all(log_dir);
+    mlog::init(log_dir);
+    mlog::set_level_info();
+
+    test_async_block();
+    test_async_drop("async_drop_newest", mlog::Overflow::DROP_NEWEST);
+    test_async_drop("async_drop_oldest", mlog::Overflow::DROP_OLDEST);
+    test_async_switch();
+    test_multi_thread("multi_thread", false);
+    test_multi_thread("multi_thread_async", true);
+    test_relink("relink", false);
+    test_relink("relink_async", true);
+    test_nested();
+    test_level_filter();
+    test_logger_level();
+    test_format("format", false);
+    test_format("format_async", true);
+    test_binary();
+    test_rotation("rotation", false);
+    test_rotation("rotation_async", true);
+    test_rotation_failed("rotation_failed", false);
+    test_rotation_failed("rotation_failed_async", true);
+    test_rotation_max_files();
+    test_ring();
+    test_sinks("sinks", false);
+    test_sinks("sinks_async", true);
+    test_sink_level("sink_level", false);
+    test_sink_level("sink_level_async", true);
+    test_sampling();
+    test_sampling_clock();
+#ifndef _WIN32
+    test_buffered_console();
+#endif
+#ifndef _WIN32
+    test_ring_crash();
+#endif
+
+    if (!pass) {
+        std::cout << "MLog test failed!\n";
+        return 1;
+    }
+
+    return 0;
+}